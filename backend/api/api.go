@@ -19,16 +19,65 @@ func GetNextOrderId() uint64 {
 
 // orders need type, side, price, quantity
 type AddFields struct {
-	TradeType string `json:"tradetype"` // GTILLCANCEL or FILLANDKILL
-	Side      string `json:"side"`      // BUY or SELL
-	Price     int    `json:"price"`     // INT
-	Quantity  int    `json:"quantity"`  // INT
-	Name      string `json:"name"`      // NAME
+	TradeType string `json:"tradetype"`  // GTC, FAK, FOK, GFD, GTT, MKT, STOP or STOPLIMIT (MKT and STOP ignore price)
+	Side      string `json:"side"`       // BUY or SELL
+	Price     int    `json:"price"`      // INT
+	Quantity  int    `json:"quantity"`   // INT
+	Name      string `json:"name"`       // NAME
+	Expiry    int64  `json:"expiry"`     // GTT only: expiry time in unix milliseconds
+	StopPrice *int   `json:"stopprice"`  // STOP and STOPLIMIT only: trigger price (a pointer, since 0 is a valid price)
+	Display   int    `json:"displayqty"` // optional iceberg display size, the rest of quantity stays hidden
+	Account   uint32 `json:"account"`    // owner id used for self-trade prevention, 0 = anonymous
+	STP       string `json:"stp"`        // CN (cancel newest, default), CO (cancel oldest), CB (cancel both) or DC (decrement)
 }
 
 type CancelFields struct {
 	OrderId int    `json:"orderID"` // OrderId
-	Book    string `json:"name"`    // book
+	Book    string `json:"name"`    // optional, the engine finds the order's book from its id
+}
+
+// a smaller quantity at the same side and price keeps the order's place in the queue, anything else re-queues it.
+type ModifyFields struct {
+	OrderId  int    `json:"orderID"`  // OrderId
+	Book     string `json:"name"`     // optional, like CancelFields
+	Side     string `json:"side"`     // BUY or SELL
+	Price    int    `json:"price"`    // INT
+	Quantity int    `json:"quantity"` // new open quantity, 0 cancels the order
+}
+
+// the kill switch: cancels every order in the book ("*" for every book) that matches all of the filters that are set.
+type CancelAllFields struct {
+	Book     string  `json:"name"`     // book, or "*"
+	Side     string  `json:"side"`     // optional, BUY or SELL
+	MinPrice *int    `json:"minprice"` // optional, inclusive (pointers, since 0 is a valid price and account)
+	MaxPrice *int    `json:"maxprice"` // optional, inclusive
+	Account  *uint32 `json:"account"`  // optional, only this account's orders
+}
+
+// one book's bid and ask. a quantity of 0 pulls that side.
+type QuoteLeg struct {
+	Book     string `json:"name"`     // book
+	BidPrice int    `json:"bidprice"` // INT
+	BidQty   int    `json:"bidqty"`   // INT
+	AskPrice int    `json:"askprice"` // INT
+	AskQty   int    `json:"askqty"`   // INT
+}
+
+// a two-sided quote in one book, or a mass quote across several. each one replaces the account's previous quote in that book.
+type QuoteFields struct {
+	Account uint32     `json:"account"` // quoting account, required
+	STP     string     `json:"stp"`     // self-trade prevention mode for the quote orders, see AddFields
+	Quotes  []QuoteLeg `json:"quotes"`
+}
+
+// a new book, created on the engine shard that owns its name.
+type BookFields struct {
+	Book string `json:"name"` // 1-32 characters of A-Z, a-z, 0-9, '.', '-' or '_'
+}
+
+type AuctionFields struct {
+	Book   string `json:"name"`   // book
+	Action string `json:"action"` // "open" starts the call, "uncross" ends it
 }
 
 func writeError(w http.ResponseWriter, message string, code int) {
@@ -0,0 +1,172 @@
+#pragma once
+
+// The server's books: each one is an Orderbook with its own lock, clock and metrics, interned by name in a BookRegistry,
+// and the OrderRouter that remembers which book each order went to. Kept apart from the HTTP layer (see Server.cpp) so
+// both can be tested on their own.
+
+#include "LatencyHistogram.h"
+#include "Orderbook.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// per-book histograms, recorded while holding the book's lock (the histograms themselves are still lock-free for readers).
+struct BookMetrics{
+    LatencyHistogram lockWait_;
+    LatencyHistogram match_;    // AddOrder start -> end
+};
+
+using BookId = std::uint32_t;
+
+struct Book{
+    Book(BookId id, std::string name, Timestamp created) : id_{ id }, name_{ std::move(name) }, now_{ created } { }
+
+    const BookId id_;
+    const std::string name_;
+    std::mutex lock_;
+    // the book's clock. every command moves it (to the time now, or on a replica to the time in the journal) before the
+    // engine runs, so the engine sees one time per command and replaying the journal sees the same ones.
+    Timestamp now_;
+    Orderbook book_{ [this]{ return now_; } };
+    BookMetrics metrics_;
+    bool changed_ = false; // journaled since its last checksum
+};
+
+class BookRegistry{
+    public:
+        static constexpr BookId MaxBooks = 1024;
+        static constexpr BookId InvalidBook = std::numeric_limits<BookId>::max();
+
+        // lock-free. the table is kept at most half full, so a probe always reaches an empty slot.
+        BookId Find(std::string_view name) const{
+            for (std::size_t i = Hash(name) & SlotMask; ; i = (i + 1) & SlotMask){
+                std::uint32_t slot = slots_[i].load(std::memory_order_acquire);
+                if (slot == EmptySlot){
+                    return InvalidBook;
+                }
+                if (books_[slot - 1]->name_ == name){
+                    return slot - 1;
+                }
+            }
+        }
+
+        // interns name if it isn't already, returns its id and whether it was added. InvalidBook once the registry is full.
+        // the book is fully built before its slot is published, so a reader that finds the id always sees a whole book.
+        std::pair<BookId, bool> Add(std::string_view name, const RiskLimits& limits, const std::vector<Timestamp>& candleIntervals, Timestamp created){
+            std::lock_guard<std::mutex> lock(addLock_);
+            BookId existing = Find(name);
+            if (existing != InvalidBook){
+                return { existing, false };
+            }
+
+            BookId id = count_.load(std::memory_order_relaxed);
+            if (id == MaxBooks){
+                return { InvalidBook, false };
+            }
+            books_[id] = std::make_unique<Book>(id, std::string(name), created);
+            books_[id]->book_.SetRiskLimits(limits);
+            books_[id]->book_.SetCandleIntervals(candleIntervals);
+            count_.store(id + 1, std::memory_order_release);
+
+            std::size_t i = Hash(name) & SlotMask;
+            while (slots_[i].load(std::memory_order_relaxed) != EmptySlot){
+                i = (i + 1) & SlotMask;
+            }
+            slots_[i].store(id + 1, std::memory_order_release);
+            return { id, true };
+        }
+
+        Book& Get(BookId id) const { return *books_[id]; }
+        BookId Size() const { return count_.load(std::memory_order_acquire); }
+
+        // visits every book added so far, in id order.
+        template <typename Visitor>
+        void ForEach(Visitor&& visit) const{
+            BookId count = Size();
+            for (BookId id = 0; id < count; id++){
+                visit(*books_[id]);
+            }
+        }
+
+    private:
+        static constexpr std::size_t SlotCount = 2 * MaxBooks;
+        static constexpr std::size_t SlotMask = SlotCount - 1;
+        static constexpr std::uint32_t EmptySlot = 0; // slots hold id + 1
+
+        static std::size_t Hash(std::string_view name){
+            return std::hash<std::string_view>{ }(name);
+        }
+
+        std::array<std::atomic<std::uint32_t>, SlotCount> slots_{ };
+        std::array<std::unique_ptr<Book>, MaxBooks> books_;
+        std::atomic<BookId> count_{ 0 };
+        std::mutex addLock_;
+};
+
+// Remembers which book each accepted order went to, so /cancel and /modify can find it without a book name. The gateway
+// hands out ids from one monotonic counter, so the table is direct-mapped: the id picks a page and a slot, no hashing.
+// Pages are allocated the first time an id lands in them and never freed. Entries are never cleared either, a stale one
+// (the order has since traded or been cancelled) just routes the request to the book that then answers "unknown order".
+// Ids past the table (clients choosing their own) fall back to a locked hash map.
+
+class OrderRouter{
+    public:
+        static constexpr unsigned PageBits = 16;
+        static constexpr std::size_t PageSize = std::size_t{ 1 } << PageBits;
+        static constexpr std::size_t MaxPages = std::size_t{ 1 } << 16; // ids below 2^32 are direct-mapped
+
+        void Record(OrderId id, BookId book){
+            if (id < PageSize * MaxPages){
+                PageFor(id >> PageBits)[id & (PageSize - 1)].store(book + 1, std::memory_order_release);
+                return;
+            }
+            std::lock_guard<std::mutex> lock(overflowLock_);
+            overflow_[id] = book;
+        }
+
+        // lock-free for direct-mapped ids. InvalidBook if the id was never placed.
+        BookId Find(OrderId id) const{
+            if (id < PageSize * MaxPages){
+                std::atomic<std::uint32_t>* page = pages_[id >> PageBits].load(std::memory_order_acquire);
+                std::uint32_t slot = page == nullptr ? EmptySlot : page[id & (PageSize - 1)].load(std::memory_order_acquire);
+                return slot == EmptySlot ? BookRegistry::InvalidBook : slot - 1;
+            }
+            std::lock_guard<std::mutex> lock(overflowLock_);
+            auto entry = overflow_.find(id);
+            return entry == overflow_.end() ? BookRegistry::InvalidBook : entry->second;
+        }
+
+    private:
+        static constexpr std::uint32_t EmptySlot = 0; // slots hold book id + 1
+
+        std::atomic<std::uint32_t>* PageFor(std::size_t index){
+            std::atomic<std::uint32_t>* page = pages_[index].load(std::memory_order_acquire);
+            if (page != nullptr){
+                return page;
+            }
+            std::lock_guard<std::mutex> lock(pageLock_);
+            if (!owned_[index]){
+                owned_[index] = std::make_unique<std::atomic<std::uint32_t>[]>(PageSize);
+                pages_[index].store(owned_[index].get(), std::memory_order_release);
+            }
+            return owned_[index].get();
+        }
+
+        std::array<std::atomic<std::atomic<std::uint32_t>*>, MaxPages> pages_{ };
+        std::array<std::unique_ptr<std::atomic<std::uint32_t>[]>, MaxPages> owned_;
+        std::mutex pageLock_;
+
+        mutable std::mutex overflowLock_;
+        std::unordered_map<OrderId, BookId> overflow_;
+};
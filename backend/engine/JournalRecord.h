@@ -0,0 +1,118 @@
+#pragma once
+
+// Running one journal record on a book. The server's journal (see Server.cpp) writes every command that changes a book
+// as a "time book op args..." line. The replica applies those lines through here, and so does the journal replay tool
+// (bench/JournalReplay.cpp), so a replayed journal drives the engine exactly the way the replica does.
+
+#include "Orderbook.h"
+
+#include <charconv>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <string>
+
+// a filter field of a "cancelall" record, "-" when the filter wasn't set.
+template <typename T>
+bool ParseJournalField(const std::string& field, std::optional<T>& value){
+    if (field == "-"){
+        return true;
+    }
+    T parsed{ };
+    auto [end, error] = std::from_chars(field.data(), field.data() + field.size(), parsed);
+    if (error != std::errc{ } || end != field.data() + field.size()){
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+// runs the book op "op" with its arguments still in "fields". "routed" is called with the id of every order that is
+// on the book afterwards because of it (an accepted order, a quote's legs), for whoever keeps an id -> book index.
+// the book's clock has to be at the record's time already. returns false for an op that isn't a book op ("book",
+// "limits" and "check" are the caller's) or a record that doesn't parse.
+template <typename Routed>
+bool ApplyBookRecord(Orderbook& book, const std::string& op, std::istream& fields, Routed&& routed){
+    if (op == "trade"){
+        OrderId orderId = 0;
+        int type = 0, side = 0, stp = 0;
+        Price price = 0, stopPrice = 0;
+        Quantity quantity = 0, displayQuantity = 0;
+        Timestamp expiry = 0;
+        AccountId account = 0;
+        fields >> orderId >> type >> side >> price >> quantity >> expiry >> stopPrice >> displayQuantity >> account >> stp;
+        if (!fields){
+            return false;
+        }
+        auto order = std::make_shared<Order>(static_cast<OrderType>(type), static_cast<Side>(side), price, quantity, orderId);
+        order->SetExpiry(expiry);
+        order->SetStopPrice(stopPrice);
+        order->SetDisplayQuantity(displayQuantity);
+        order->SetOwner(account, static_cast<SelfTradePrevention>(stp));
+        if (book.AddOrder(order)){
+            routed(orderId);
+        }
+    }else if (op == "cancel"){
+        OrderId orderId = 0;
+        fields >> orderId;
+        if (!fields){
+            return false;
+        }
+        book.CancelOrder(orderId);
+    }else if (op == "modify"){
+        OrderId orderId = 0;
+        int side = 0;
+        Price price = 0;
+        Quantity quantity = 0;
+        fields >> orderId >> side >> price >> quantity;
+        if (!fields){
+            return false;
+        }
+        book.MatchOrder(OrderModify{ orderId, static_cast<Side>(side), price, quantity });
+    }else if (op == "quote"){
+        Quote quote;
+        int stp = 0;
+        fields >> quote.owner_ >> stp >> quote.bid_.orderId_ >> quote.bid_.price_ >> quote.bid_.quantity_
+            >> quote.ask_.orderId_ >> quote.ask_.price_ >> quote.ask_.quantity_;
+        if (!fields){
+            return false;
+        }
+        quote.selfTradePrevention_ = static_cast<SelfTradePrevention>(stp);
+        // a quote the primary refused after journaling it (see server_quote) is refused here too, with the same effects.
+        if (Result<QuoteAck> ack = book.UpdateQuote(quote)){
+            for (OrderId leg : { ack->bidId_, ack->askId_ }){
+                if (leg != 0){
+                    routed(leg);
+                }
+            }
+        }
+    }else if (op == "cancelall"){
+        std::string side, minPrice, maxPrice, owner;
+        fields >> side >> minPrice >> maxPrice >> owner;
+        MassCancelFilter filter;
+        std::optional<int> sideValue;
+        if (!fields || !ParseJournalField(side, sideValue) || !ParseJournalField(minPrice, filter.minPrice_)
+            || !ParseJournalField(maxPrice, filter.maxPrice_) || !ParseJournalField(owner, filter.owner_)){
+            return false;
+        }
+        if (sideValue){
+            filter.side_ = static_cast<Side>(*sideValue);
+        }
+        book.CancelOrders(filter);
+    }else if (op == "auction"){
+        std::string action;
+        fields >> action;
+        if (action == "open"){
+            book.OpenAuction();
+        }else if (action == "uncross"){
+            book.UncrossAuction();
+        }else{
+            return false;
+        }
+    }else if (op == "expire"){
+        book.ExpireOrders();
+    }else{
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+// The clock and histogram behind the server's latency instrumentation (see /metrics in Server.cpp). Kept apart from the
+// HTTP layer so they can be tested on their own.
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #else
+        #include <x86intrin.h>
+    #endif
+    #define ORDERBOOK_HAS_RDTSC 1
+#endif
+
+// TickClock reads the TSC on x86 (a single instruction, no syscall) and steady_clock everywhere else.
+// Calibrate() runs once at startup so we can convert ticks back to nanoseconds for reporting.
+struct TickClock{
+    static std::uint64_t Now(){
+#ifdef ORDERBOOK_HAS_RDTSC
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    static void Calibrate(){
+#ifdef ORDERBOOK_HAS_RDTSC
+        auto wallStart = std::chrono::steady_clock::now();
+        std::uint64_t tickStart = Now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        std::uint64_t tickEnd = Now();
+        auto wallNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - wallStart).count();
+        if (tickEnd > tickStart){
+            nanosPerTick_ = static_cast<double>(wallNanos) / static_cast<double>(tickEnd - tickStart);
+        }
+#endif
+    }
+
+    static std::uint64_t ToNanos(std::uint64_t ticks){
+        return static_cast<std::uint64_t>(static_cast<double>(ticks) * nanosPerTick_);
+    }
+
+    static inline double nanosPerTick_ = 1.0;
+};
+
+// Log-linear histogram (HdrHistogram style): every power of two is split into 16 linear sub-buckets,
+// so any recorded value is off by at most ~6%. Buckets are plain atomics, so recording is one relaxed fetch_add
+// and readers never block writers.
+class LatencyHistogram{
+    public:
+        static constexpr int SubBucketBits = 4;
+        static constexpr std::uint64_t SubBuckets = 1ull << SubBucketBits;
+        static constexpr std::size_t BucketCount = (64 - SubBucketBits + 1) * SubBuckets;
+
+        void Record(std::uint64_t nanos){
+            buckets_[BucketFor(nanos)].fetch_add(1, std::memory_order_relaxed);
+            count_.fetch_add(1, std::memory_order_relaxed);
+            sum_.fetch_add(nanos, std::memory_order_relaxed);
+        }
+
+        std::uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+        std::uint64_t Sum() const { return sum_.load(std::memory_order_relaxed); }
+
+        // returns the upper bound of the bucket holding the q-th quantile (0 < q <= 1), in nanoseconds.
+        std::uint64_t Percentile(double q) const{
+            std::uint64_t total = 0;
+            for (const auto& bucket : buckets_){
+                total += bucket.load(std::memory_order_relaxed);
+            }
+            if (total == 0){
+                return 0;
+            }
+
+            std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(total)));
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < BucketCount; i++){
+                seen += buckets_[i].load(std::memory_order_relaxed);
+                if (seen >= rank){
+                    return UpperBound(i);
+                }
+            }
+            return UpperBound(BucketCount - 1);
+        }
+
+    private:
+        static std::size_t BucketFor(std::uint64_t value){
+            if (value < SubBuckets){
+                return value;
+            }
+            int shift = (63 - std::countl_zero(value)) - SubBucketBits;
+            return (shift + 1) * SubBuckets + ((value >> shift) & (SubBuckets - 1));
+        }
+
+        static std::uint64_t UpperBound(std::size_t bucket){
+            std::uint64_t group = bucket / SubBuckets;
+            std::uint64_t sub = bucket % SubBuckets;
+            if (group == 0){
+                return sub;
+            }
+            return ((SubBuckets + sub + 1) << (group - 1)) - 1;
+        }
+
+        std::array<std::atomic<std::uint64_t>, BucketCount> buckets_{};
+        std::atomic<std::uint64_t> count_{0};
+        std::atomic<std::uint64_t> sum_{0};
+};
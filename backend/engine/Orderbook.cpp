@@ -0,0 +1,1201 @@
+#include "Orderbook.h"
+
+#include <atomic>
+#include <cstdio>
+
+namespace {
+
+void DefaultAssertHandler(const char* expression, const char* file, int line){
+    std::fprintf(stderr, "orderbook: invariant violated: %s (%s:%d)\n", expression, file, line);
+}
+
+std::atomic<AssertHandler> gAssertHandler { DefaultAssertHandler };
+
+}
+
+void SetAssertHandler(AssertHandler handler){
+    gAssertHandler.store(handler ? handler : DefaultAssertHandler);
+}
+
+void AssertFailed(const char* expression, const char* file, int line){
+    gAssertHandler.load()(expression, file, line);
+    std::abort();
+}
+
+void Orderbook::CancelStopOrder(OrderId orderId){
+    auto entry = stops_.find(orderId);
+    ORDERBOOK_ASSERT(entry != stops_.end());
+    const OrderIndex index = entry->second;
+    const Price stopPrice = pool_.Cold(index).stopPrice_;
+    stops_.erase(entry);
+
+    if (pool_.Hot(index).side_ == Side::Buy){
+        auto level = buyStops_.find(stopPrice);
+        pool_.Unlink(level->second, index);
+        if (level->second.Empty()){
+            buyStops_.erase(level);
+        }
+    }else{
+        auto level = sellStops_.find(stopPrice);
+        pool_.Unlink(level->second, index);
+        if (level->second.Empty()){
+            sellStops_.erase(level);
+        }
+    }
+    FreeOrder(index);
+}
+
+void Orderbook::ProcessTriggeredStops(Trades& trades){
+    std::deque<OrderIndex> pending;
+    CollectTriggered(buyStops_, pending);
+    CollectTriggered(sellStops_, pending);
+
+    while (!pending.empty()){
+        OrderIndex index = pending.front();
+        pending.pop_front();
+
+        pool_.Hot(index).Trigger();
+        // a triggered stop that is refused (a stop-market reaching an empty book is fine, it just doesn't trade) is dropped.
+        Result<Trades> triggeredTrades = ExecuteOrder(index);
+        if (triggeredTrades){
+            trades.insert(trades.end(), triggeredTrades->begin(), triggeredTrades->end());
+        }
+
+        CollectTriggered(buyStops_, pending);
+        CollectTriggered(sellStops_, pending);
+    }
+}
+
+AuctionIndicative Orderbook::ComputeEquilibrium() const{
+    struct DepthPoint{
+        Price price_;
+        std::uint64_t bidQuantity_ { 0 };
+        std::uint64_t askQuantity_ { 0 };
+        std::uint64_t demand_ { 0 };
+        std::uint64_t supply_ { 0 };
+    };
+    auto executable = [](const LevelData& data){ return std::uint64_t{ data.quantity_ } + data.hiddenQuantity_; };
+
+    std::vector<DepthPoint> depth;
+    depth.reserve(bids_.size() + asks_.size());
+    auto bid = bids_.rbegin(); // bids_ is stored best (highest) first, walk it backwards to go up in price.
+    auto ask = asks_.begin();
+    while (bid != bids_.rend() || ask != asks_.end()){
+        Price price = (ask == asks_.end() || (bid != bids_.rend() && bid->first < ask->first)) ? bid->first : ask->first;
+        DepthPoint point{ price };
+        if (bid != bids_.rend() && bid->first == price){
+            point.bidQuantity_ = executable(bidData_.at(price));
+            ++bid;
+        }
+        if (ask != asks_.end() && ask->first == price){
+            point.askQuantity_ = executable(askData_.at(price));
+            ++ask;
+        }
+        depth.push_back(point);
+    }
+
+    std::uint64_t supply = 0;
+    for (DepthPoint& point : depth){
+        supply += point.askQuantity_;
+        point.supply_ = supply;
+    }
+    std::uint64_t demand = 0;
+    for (auto point = depth.rbegin(); point != depth.rend(); ++point){
+        demand += point->bidQuantity_;
+        point->demand_ = demand;
+    }
+
+    AuctionIndicative best;
+    for (const DepthPoint& point : depth){
+        std::uint64_t volume = std::min(point.demand_, point.supply_);
+        std::int64_t imbalance = static_cast<std::int64_t>(point.demand_) - static_cast<std::int64_t>(point.supply_);
+        if (volume == 0){
+            continue;
+        }
+
+        bool better = !best.price_ || volume > best.volume_;
+        if (!better && volume == best.volume_){
+            if (std::abs(imbalance) != std::abs(best.imbalance_)){
+                better = std::abs(imbalance) < std::abs(best.imbalance_);
+            }else if (lastTradePrice_){
+                better = std::abs(static_cast<std::int64_t>(point.price_) - *lastTradePrice_) < std::abs(static_cast<std::int64_t>(*best.price_) - *lastTradePrice_);
+            }
+        }
+        if (better){
+            best = AuctionIndicative{ point.price_, volume, imbalance };
+        }
+    }
+    return best;
+}
+
+void Orderbook::UpdateLevelData(OrderIndex index, Quantity quantity, LevelData::Action action, Quantity hiddenQuantity){
+    const Side side = pool_.Hot(index).side_;
+    const Price price = pool_.Hot(index).price_;
+    auto& levels = side == Side::Buy ? bidData_ : askData_;
+    auto& data = levels[price];
+    levelVersion_++;
+
+    if (action == LevelData::Action::Add){
+        data.count_ += 1;
+        data.quantity_ += quantity;
+        data.hiddenQuantity_ += hiddenQuantity;
+    }else if (action == LevelData::Action::Remove){
+        ORDERBOOK_ASSERT(data.count_ != 0 && data.quantity_ >= quantity && data.hiddenQuantity_ >= hiddenQuantity);
+        data.count_ -= 1;
+        data.quantity_ -= quantity;
+        data.hiddenQuantity_ -= hiddenQuantity;
+    }else if (action == LevelData::Action::Replenish){
+        data.quantity_ += quantity;
+        data.hiddenQuantity_ -= quantity;
+    }else if (action == LevelData::Action::Reduce){
+        ORDERBOOK_ASSERT(data.quantity_ >= quantity && data.hiddenQuantity_ >= hiddenQuantity);
+        data.quantity_ -= quantity;
+        data.hiddenQuantity_ -= hiddenQuantity;
+    }else{
+        ORDERBOOK_ASSERT(data.quantity_ >= quantity);
+        data.quantity_ -= quantity;
+    }
+
+    if (action != LevelData::Action::Replenish){
+        std::int64_t executable = std::int64_t{ quantity } + hiddenQuantity;
+        UpdateOwnerQuantity(side, price, pool_.Hot(index).owner_, action == LevelData::Action::Add ? executable : -executable);
+    }
+
+    if (data.count_ == 0){
+        levels.erase(price);
+    }else if (data.queue_){
+        UpdateQueueIndex(data, index, quantity, action);
+    }
+
+    bool shown = action == LevelData::Action::Add || action == LevelData::Action::Replenish;
+    std::int64_t displayed = shown ? std::int64_t{ quantity } : -std::int64_t{ quantity };
+    if (displayed != 0){
+        side == Side::Buy ? UpdateDepth<Side::Buy>(price, displayed) : UpdateDepth<Side::Sell>(price, displayed);
+    }
+}
+
+void Orderbook::UpdateQueueIndex(LevelData& data, OrderIndex index, Quantity quantity, LevelData::Action action){
+    QueueIndex& queue = *data.queue_;
+    std::uint32_t& slot = pool_.Cold(index).queueSlot_;
+    switch (action){
+        case LevelData::Action::Add:
+            if (!queue.Append(quantity, slot)){
+                data.queue_.reset(); // rebuilt from the level the next time a position is asked for.
+            }
+            break;
+        case LevelData::Action::Remove:
+            queue.Remove(slot);
+            break;
+        case LevelData::Action::Replenish:
+            // the iceberg goes to the back of the level with its new slice.
+            queue.Remove(slot);
+            if (!queue.Append(pool_.Hot(index).remaining_, slot)){
+                data.queue_.reset();
+            }
+            break;
+        default:
+            queue.Add(slot, 0, -std::int64_t{ quantity });
+            break;
+    }
+}
+
+template <Side S>
+QueueIndex::Sums Orderbook::QueueAhead(OrderIndex index){
+    Price price = pool_.Hot(index).price_;
+    LevelData& data = LevelDataFor<S>().at(price);
+    if (!data.queue_){
+        // room for as many arrivals again as there are orders now, so building it never fails.
+        data.queue_ = std::make_unique<QueueIndex>(std::bit_ceil(std::max<std::size_t>(16, 2 * std::size_t{ data.count_ })));
+        for (OrderIndex queued = LevelsFor<S>().at(price).head_; queued != NoOrder; queued = pool_.Hot(queued).next_){
+            data.queue_->Append(pool_.Hot(queued).remaining_, pool_.Cold(queued).queueSlot_);
+        }
+    }
+    return data.queue_->Before(pool_.Cold(index).queueSlot_);
+}
+
+Result<OrderStatus> Orderbook::GetOrderStatus(OrderId orderId){
+    ExpireOrders();
+    if (auto entry = orders_.find(orderId); entry != orders_.end()){
+        OrderIndex index = entry->second;
+        const OrderHot& order = pool_.Hot(index);
+        OrderStatus status{ orderId, OrderState::Resting, order.side_, order.price_, pool_.Cold(index).initial_ };
+        status.remaining_ = order.remaining_ + order.hidden_;
+        status.filled_ = status.initial_ - status.remaining_;
+        if (status.filled_ != 0){
+            status.state_ = OrderState::PartiallyFilled;
+        }
+        QueueIndex::Sums ahead = order.side_ == Side::Buy ? QueueAhead<Side::Buy>(index) : QueueAhead<Side::Sell>(index);
+        status.ordersAhead_ = static_cast<std::uint64_t>(ahead.orders_);
+        status.quantityAhead_ = static_cast<std::uint64_t>(ahead.quantity_);
+        return status;
+    }
+    if (auto entry = stops_.find(orderId); entry != stops_.end()){
+        const OrderHot& order = pool_.Hot(entry->second);
+        Quantity initial = pool_.Cold(entry->second).initial_;
+        return OrderStatus{ orderId, OrderState::Pending, order.side_, order.price_, initial, 0, initial };
+    }
+    if (const FinishedOrders::Entry* finished = finished_.Find(orderId)){
+        OrderState state = finished->rejected_ ? OrderState::Rejected
+            : finished->filled_ == finished->initial_ ? OrderState::Filled : OrderState::Cancelled;
+        return OrderStatus{ orderId, state, finished->side_, finished->price_, finished->initial_, finished->filled_ };
+    }
+    return std::unexpected(OrderError::UnknownOrder);
+}
+
+template <Side S>
+void Orderbook::UpdateDepth(Price price, std::int64_t quantity){
+    DepthLadder& depth = DepthFor<S>();
+    std::int64_t rank = Rank<S>(price);
+    if (depth.Contains(rank)){
+        depth.Add(rank, quantity, price);
+        return;
+    }
+    // past the far end of the window is fine as long as the window can't grow that far, anything else (a new touch
+    // before the window, a first level, a level a bigger window would still reach) gets the tree rebuilt around it.
+    if (!depth.Empty() && rank >= depth.End() && static_cast<std::uint64_t>(rank - depth.Low()) >= DepthLadder::MaxSize){
+        return;
+    }
+    RebuildDepth<S>();
+}
+
+template <Side S>
+void Orderbook::RebuildDepth(){
+    DepthLadder& depth = DepthFor<S>();
+    const auto& data = LevelDataFor<S>();
+    if (data.empty()){
+        depth.Clear();
+        return;
+    }
+
+    std::int64_t best = std::numeric_limits<std::int64_t>::max();
+    std::int64_t worst = std::numeric_limits<std::int64_t>::min();
+    for (const auto& [price, _] : data){
+        best = std::min(best, Rank<S>(price));
+        worst = std::max(worst, Rank<S>(price));
+    }
+    // twice the current spread of levels, and a quarter of the window in front of the touch so it can improve a
+    // few ticks without another rebuild.
+    std::uint64_t span = static_cast<std::uint64_t>(worst - best) + 1;
+    std::size_t size = std::bit_ceil(std::clamp<std::uint64_t>(2 * span, DepthLadder::MinSize, DepthLadder::MaxSize));
+    depth.Reset(best - static_cast<std::int64_t>(size / 4), size);
+    for (const auto& [price, level] : data){
+        if (depth.Contains(Rank<S>(price))){
+            depth.Add(Rank<S>(price), level.quantity_, price);
+        }
+    }
+}
+
+FillEstimate Orderbook::EstimateFill(Side side, Quantity quantity) const{
+    return side == Side::Buy ? EstimateFill<Side::Sell>(quantity) : EstimateFill<Side::Buy>(quantity);
+}
+
+std::uint64_t Orderbook::QuantityAvailable(Side side, Price limit) const{
+    return side == Side::Buy ? QuantityAvailable<Side::Sell>(limit) : QuantityAvailable<Side::Buy>(limit);
+}
+
+template <Side S>
+FillEstimate Orderbook::EstimateFill(Quantity quantity) const{
+    const DepthLadder& depth = DepthFor<S>();
+    FillEstimate estimate;
+    if (quantity == 0 || depth.Empty()){
+        return estimate;
+    }
+
+    DepthLadder::Sums total = depth.Total();
+    if (total.quantity_ >= quantity){
+        auto [rank, before] = depth.Search(quantity);
+        Price price = PriceAt<S>(rank);
+        estimate.quantity_ = quantity;
+        estimate.notional_ = before.notional_ + (quantity - before.quantity_) * std::int64_t{ price };
+        estimate.worstPrice_ = price;
+        return estimate;
+    }
+
+    estimate.quantity_ = static_cast<std::uint64_t>(total.quantity_);
+    estimate.notional_ = total.notional_;
+    if (total.quantity_ > 0){
+        estimate.worstPrice_ = PriceAt<S>(depth.Search(total.quantity_).first);
+    }
+    // the window ran out, carry on through the levels past its end.
+    const auto& levels = LevelsFor<S>();
+    const auto& data = LevelDataFor<S>();
+    for (auto level = levels.lower_bound(PriceAt<S>(depth.End())); level != levels.end() && estimate.quantity_ < quantity; ++level){
+        std::uint64_t take = std::min<std::uint64_t>(data.at(level->first).quantity_, quantity - estimate.quantity_);
+        estimate.quantity_ += take;
+        estimate.notional_ += static_cast<std::int64_t>(take) * level->first;
+        estimate.worstPrice_ = level->first;
+    }
+    return estimate;
+}
+
+template <Side S>
+std::uint64_t Orderbook::QuantityAvailable(Price limit) const{
+    const DepthLadder& depth = DepthFor<S>();
+    std::int64_t rank = Rank<S>(limit);
+    if (depth.Empty() || rank < depth.End()){
+        return depth.Empty() ? 0 : static_cast<std::uint64_t>(depth.Prefix(rank).quantity_);
+    }
+
+    std::uint64_t available = static_cast<std::uint64_t>(depth.Total().quantity_);
+    const auto& levels = LevelsFor<S>();
+    const auto& data = LevelDataFor<S>();
+    for (auto level = levels.lower_bound(PriceAt<S>(depth.End())); level != levels.end() && Rank<S>(level->first) <= rank; ++level){
+        available += data.at(level->first).quantity_;
+    }
+    return available;
+}
+
+void Orderbook::OnOrderMatched(OrderIndex index, Quantity quantity){
+    const OrderHot& order = pool_.Hot(index);
+    UpdateLevelData(index, quantity, order.IsFilled() ? LevelData::Action::Remove : LevelData::Action::Match);
+    UpdateOpenRisk(order, -std::int64_t{ quantity });
+    if (order.IsFilled()){
+        AccountFor(order.owner_).openOrders_--;
+    }
+}
+
+void Orderbook::SettleFront(LevelQueue& level){
+    OrderIndex index = level.head_;
+    const OrderHot& order = pool_.Hot(index);
+    if (order.IsFilled()){
+        pool_.Unlink(level, index);
+        EraseOrder(index);
+    }else if (order.NeedsReplenish()){
+        ReplenishIceberg(level);
+    }
+}
+
+bool Orderbook::PreventSelfTrade(OrderIndex newest, LevelQueue* newestLevel, LevelQueue& oldestLevel){
+    OrderIndex oldest = oldestLevel.head_;
+
+    switch (pool_.Hot(newest).selfTradePrevention_){
+        case SelfTradePrevention::CancelOldest:
+            CancelFront(oldestLevel);
+            return false;
+        case SelfTradePrevention::CancelBoth:
+            CancelFront(oldestLevel);
+            if (newestLevel){
+                CancelFront(*newestLevel);
+            }
+            return true;
+        case SelfTradePrevention::Decrement:{
+            // both orders shrink by the overlap and no trade is printed. the smaller one ends up empty and leaves the book.
+            Quantity quantity = std::min(pool_.Hot(newest).remaining_, pool_.Hot(oldest).remaining_);
+            for (OrderIndex index : { newest, oldest }){
+                pool_.Hot(index).remaining_ -= quantity;
+                pool_.Cold(index).initial_ -= quantity;
+            }
+            OnOrderMatched(oldest, quantity);
+            SettleFront(oldestLevel);
+            if (newestLevel){
+                OnOrderMatched(newest, quantity);
+                SettleFront(*newestLevel);
+            }
+            return false;
+        }
+        case SelfTradePrevention::CancelNewest:
+        default:
+            if (newestLevel){
+                CancelFront(*newestLevel);
+            }
+            return true;
+    }
+}
+
+Trades Orderbook::MatchOrders(OrderIndex incoming, std::optional<Price> auctionPrice){
+    Trades trades;
+
+    while (true){
+        if (bids_.empty() || asks_.empty()){ 
+            break;
+        }
+
+        auto& [askPrice, asks] = *asks_.begin();
+        auto& [bidPrice, bids] = *bids_.begin();
+
+        if (bidPrice < askPrice){ 
+            break; 
+        }
+        if (auctionPrice && (bidPrice < *auctionPrice || askPrice > *auctionPrice)){
+            break;
+        }
+
+        while (!bids.Empty() && !asks.Empty()){
+            OrderIndex bidIndex = bids.head_;
+            OrderIndex askIndex = asks.head_;
+            OrderHot& bid = pool_.Hot(bidIndex);
+            OrderHot& ask = pool_.Hot(askIndex);
+
+            // a single integer compare on the fast path, owner 0 means "no owner" and never self-trades.
+            if (bid.owner_ == ask.owner_ && bid.owner_ != 0) [[unlikely]] {
+                // with no incoming order (auction uncross), the higher order id is the newer one.
+                bool bidIsNewest = incoming != NoOrder ? bidIndex == incoming : bid.orderId_ > ask.orderId_;
+                if (bidIsNewest){
+                    PreventSelfTrade(bidIndex, &bids, asks);
+                }else{
+                    PreventSelfTrade(askIndex, &asks, bids);
+                }
+                continue;
+            }
+
+            Quantity quantity = std::min(bid.remaining_, ask.remaining_);
+            ORDERBOOK_ASSERT(quantity != 0); // an empty order at the front of a level would never leave it.
+
+            bid.remaining_ -= quantity;
+            ask.remaining_ -= quantity;
+            OnOrderMatched(bidIndex, quantity);
+            OnOrderMatched(askIndex, quantity);
+
+            RecordFill(bid.owner_, ask.owner_, quantity);
+            if (auctionPrice){
+                RecordTrade(bid.orderId_, ask.orderId_, *auctionPrice, quantity, bid.orderId_ > ask.orderId_ ? Side::Buy : Side::Sell, true);
+            }else{
+                // the incoming order is the aggressor and the other side sets the price, the same way lastTradePrice_ is set.
+                bool buyerAggressed = pool_.Hot(incoming).side_ == Side::Buy;
+                RecordTrade(bid.orderId_, ask.orderId_, buyerAggressed ? ask.price_ : bid.price_, quantity, buyerAggressed ? Side::Buy : Side::Sell);
+            }
+            trades.push_back(Trade{
+                TradeInfo{ bid.orderId_, auctionPrice.value_or(bid.price_), quantity},
+                TradeInfo{ ask.orderId_, auctionPrice.value_or(ask.price_), quantity}
+            });
+
+            SettleFront(bids);
+            SettleFront(asks);
+        }
+
+        if (bids.Empty()){ 
+            bids_.erase(bidPrice);
+        }
+        if (asks.Empty()){ 
+            asks_.erase(askPrice);
+        }
+    }
+
+    // Handle FillAndKill orders that didn't fully fill
+    if (!bids_.empty()){
+        const OrderHot& order = pool_.Hot(bids_.begin()->second.head_);
+        if (order.type_ == OrderType::FillAndKill && !order.IsFilled()){
+            CancelOrder(order.orderId_);
+        }
+    }
+
+    if (!asks_.empty()){
+        const OrderHot& order = pool_.Hot(asks_.begin()->second.head_);
+        if (order.type_ == OrderType::FillAndKill && !order.IsFilled()){
+            CancelOrder(order.orderId_);
+        }
+    }
+
+    return trades;
+}
+
+template <Side S>
+Trades Orderbook::SweepOrder(OrderIndex aggressorIndex, Price limit){
+    Trades trades;
+    OrderHot& aggressor = pool_.Hot(aggressorIndex);
+    auto& levels = LevelsFor<SideTraits<S>::Opposite>();
+    while (!aggressor.IsFilled() && !levels.empty()){
+        auto levelIterator = levels.begin();
+        auto& [levelPrice, restingOrders] = *levelIterator;
+        if (!SideTraits<S>::Crosses(limit, levelPrice)){
+            break; // this level (and every one after it) is worse than the aggressor's limit.
+        }
+
+        while (!aggressor.IsFilled() && !restingOrders.Empty()){
+            OrderIndex restingIndex = restingOrders.head_;
+            OrderHot& resting = pool_.Hot(restingIndex);
+
+            if (resting.owner_ == aggressor.owner_ && resting.owner_ != 0) [[unlikely]] {
+                if (PreventSelfTrade(aggressorIndex, nullptr, restingOrders)){
+                    // the aggressor was cancelled, whatever it has left is dropped like any other unfilled remainder.
+                    if (restingOrders.Empty()){
+                        levels.erase(levelIterator);
+                    }
+                    return trades;
+                }
+                continue;
+            }
+
+            Quantity quantity = std::min(aggressor.remaining_, resting.remaining_);
+            ORDERBOOK_ASSERT(quantity != 0);
+
+            aggressor.remaining_ -= quantity;
+            resting.remaining_ -= quantity;
+            OnOrderMatched(restingIndex, quantity);
+
+            // the resting order sets the execution price.
+            lastTradePrice_ = levelPrice;
+            lastTradeQuantity_ = quantity;
+            TradeInfo aggressorTrade{ aggressor.orderId_, levelPrice, quantity };
+            TradeInfo restingTrade{ resting.orderId_, levelPrice, quantity };
+            if constexpr (S == Side::Buy){
+                RecordFill(aggressor.owner_, resting.owner_, quantity);
+                RecordTrade(aggressor.orderId_, resting.orderId_, levelPrice, quantity, S);
+                trades.push_back(Trade{ aggressorTrade, restingTrade });
+            }else{
+                RecordFill(resting.owner_, aggressor.owner_, quantity);
+                RecordTrade(resting.orderId_, aggressor.orderId_, levelPrice, quantity, S);
+                trades.push_back(Trade{ restingTrade, aggressorTrade });
+            }
+
+            SettleFront(restingOrders);
+        }
+
+        if (restingOrders.Empty()){
+            levels.erase(levelIterator);
+        }
+    }
+    return trades;
+}
+
+void Orderbook::ExpireOrders(){
+    PublishOnReturn publish{ *this };
+    std::vector<OrderId> expired;
+    now_ = clock_();
+    expiryWheel_.Advance(now_, [this, &expired](OrderId orderId){
+        // the wheel has already released this timer, so don't let CancelOrder disarm it a second time.
+        auto entry = orders_.find(orderId);
+        ORDERBOOK_ASSERT(entry != orders_.end());
+        pool_.Cold(entry->second).expiryTimer_ = TimerWheel::InvalidTimer;
+        expired.push_back(orderId);
+    });
+    for (OrderId orderId : expired){
+        CancelOrder(orderId);
+    }
+}
+
+void Orderbook::PublishTopOfBook(){
+    if (publishedVersion_ == levelVersion_){
+        return;
+    }
+    publishedVersion_ = levelVersion_;
+
+    TopOfBook top;
+    if (!bids_.empty()){
+        top.bidPrice_ = bids_.begin()->first;
+        top.bidQuantity_ = bidData_.at(top.bidPrice_).quantity_;
+    }
+    if (!asks_.empty()){
+        top.askPrice_ = asks_.begin()->first;
+        top.askQuantity_ = askData_.at(top.askPrice_).quantity_;
+    }
+    if (lastTradePrice_){
+        top.lastTradePrice_ = *lastTradePrice_;
+        top.lastTradeQuantity_ = lastTradeQuantity_;
+    }
+    // most level updates are behind the touch, so readers only see a new sequence when the touch or last trade moved.
+    if (top != published_){
+        published_ = top;
+        topOfBook_.Store(top);
+    }
+}
+
+Result<Trades> Orderbook::AddOrder(OrderPointer order){
+    PublishOnReturn publish{ *this };
+    ExpireOrders();
+    if (orders_.contains(order->GetOrderId()) || stops_.contains(order->GetOrderId())){
+        return std::unexpected(OrderError::DuplicateOrderId);
+    }
+
+    OrderIndex index = pool_.Allocate(*order);
+
+    // a stop rests in the trigger index until the market reaches it. one that has already been reached goes straight in.
+    if (order->IsStopOrder()){
+        if (!IsTriggered(index)){
+            AddStopOrder(index);
+            return Trades{ };
+        }
+        pool_.Hot(index).Trigger();
+    }
+
+    Result<Trades> trades = ExecuteOrder(index);
+    if (trades){
+        ProcessTriggeredStops(*trades);
+    }
+
+    // nothing above allocates, so the slot still holds the order's final state even if it has already been freed.
+    const OrderHot& hot = pool_.Hot(index);
+    const OrderCold& cold = pool_.Cold(index);
+    order->SetQuantities(cold.initial_, hot.remaining_, hot.hidden_);
+    order->SetExpiry(cold.expiry_);
+    return trades;
+}
+
+RiskReject Orderbook::CheckRisk(const Order& order) const{
+    return CheckRisk(order, GetAccountRisk(order.GetOwner()));
+}
+
+RiskReject Orderbook::CheckRisk(const OrderModify& modify) const{
+    auto entry = orders_.find(modify.GetOrderId());
+    if (entry == orders_.end() || modify.GetQuantity() == 0){
+        return RiskReject::None; // nothing to check, MatchOrder() refuses it or cancels the order.
+    }
+    const OrderHot& existing = pool_.Hot(entry->second);
+    Quantity open = existing.remaining_ + existing.hidden_;
+    if (modify.GetSide() == existing.side_ && modify.GetPrice() == existing.price_ && modify.GetQuantity() <= open){
+        return RiskReject::None; // cut in place, it can only lower the account's risk.
+    }
+
+    Order replacement(existing.type_, modify.GetSide(), modify.GetPrice(), modify.GetQuantity(), modify.GetOrderId());
+    replacement.SetOwner(existing.owner_, existing.selfTradePrevention_);
+    return CheckRisk(replacement, WithoutOrder(GetAccountRisk(existing.owner_), existing));
+}
+
+RiskReject Orderbook::CheckRisk(const Quote& quote) const{
+    // the account as it would be with its live legs pulled. a leg that has been modified onto the other side isn't
+    // replaced by the quote (see PlaceQuoteSide()), so it stays counted.
+    AccountRisk account = GetAccountRisk(quote.owner_);
+    auto current = quotes_.find(quote.owner_);
+    QuoteOrders live = current != quotes_.end() ? current->second : QuoteOrders{ };
+    for (auto [side, liveId] : { std::pair{ Side::Buy, live.bid_ }, std::pair{ Side::Sell, live.ask_ } }){
+        auto entry = liveId != 0 ? orders_.find(liveId) : orders_.end();
+        if (entry != orders_.end() && pool_.Hot(entry->second).side_ == side){
+            account = WithoutOrder(account, pool_.Hot(entry->second));
+        }
+    }
+
+    // then each leg in turn, the ask counted with the bid already resting.
+    for (auto [side, leg] : { std::pair{ Side::Buy, &quote.bid_ }, std::pair{ Side::Sell, &quote.ask_ } }){
+        if (leg->quantity_ == 0){
+            continue;
+        }
+        Order order(OrderType::GoodTillCancel, side, leg->price_, leg->quantity_, leg->orderId_);
+        order.SetOwner(quote.owner_, quote.selfTradePrevention_);
+        if (RiskReject reject = CheckRisk(order, account); reject != RiskReject::None){
+            return reject;
+        }
+        account.openOrders_++;
+        (side == Side::Buy ? account.openBuyQuantity_ : account.openSellQuantity_) += leg->quantity_;
+        account.openNotional_ += Notional(leg->price_, leg->quantity_);
+    }
+    return RiskReject::None;
+}
+
+RiskReject Orderbook::CheckRisk(const Order& order, const AccountRisk& account) const{
+    const RiskLimits& limits = riskLimits_;
+    std::uint64_t quantity = std::uint64_t{ order.GetRemainingQuantity() } + order.GetHiddenQuantity();
+
+    if (limits.maxOrderQuantity_ != 0 && quantity > limits.maxOrderQuantity_){
+        return RiskReject::OrderQuantity;
+    }
+
+    bool hasPrice = order.GetOrderType() != OrderType::Market && order.GetOrderType() != OrderType::Stop;
+    std::optional<Price> price = hasPrice ? std::optional<Price>{ order.GetPrice() } : lastTradePrice_;
+    std::uint64_t notional = price ? Notional(*price, quantity) : 0;
+    if (limits.maxOrderNotional_ != 0 && notional > limits.maxOrderNotional_){
+        return RiskReject::OrderNotional;
+    }
+
+    if (order.GetOwner() == 0){
+        return RiskReject::None;
+    }
+
+    if (limits.maxOpenOrders_ != 0 && account.openOrders_ >= limits.maxOpenOrders_){
+        return RiskReject::OpenOrders;
+    }
+
+    std::int64_t worstPosition = order.GetSide() == Side::Buy
+        ? account.position_ + static_cast<std::int64_t>(account.openBuyQuantity_ + quantity)
+        : account.position_ - static_cast<std::int64_t>(account.openSellQuantity_ + quantity);
+    if (limits.maxPosition_ != 0 && static_cast<std::uint64_t>(std::abs(worstPosition)) > limits.maxPosition_){
+        return RiskReject::Position;
+    }
+
+    if (limits.maxExposure_ != 0 && account.openNotional_ + notional > limits.maxExposure_){
+        return RiskReject::Exposure;
+    }
+    return RiskReject::None;
+}
+
+AuctionIndicative Orderbook::GetAuctionIndicative() const{
+    if (phase_ != TradingPhase::Auction){
+        return { };
+    }
+    if (indicativeVersion_ != levelVersion_){
+        indicative_ = ComputeEquilibrium();
+        indicativeVersion_ = levelVersion_;
+    }
+    return indicative_;
+}
+
+Result<Trades> Orderbook::UncrossAuction(){
+    PublishOnReturn publish{ *this };
+    ExpireOrders();
+    if (phase_ != TradingPhase::Auction){
+        return std::unexpected(OrderError::NotInAuction);
+    }
+
+    AuctionIndicative equilibrium = ComputeEquilibrium();
+    phase_ = TradingPhase::Continuous;
+
+    Trades trades;
+    if (equilibrium.price_){
+        trades = MatchOrders(NoOrder, equilibrium.price_);
+        lastTradePrice_ = equilibrium.price_;
+        lastTradeQuantity_ = trades.empty() ? lastTradeQuantity_ : trades.back().GetBidTrade().quantity_;
+    }
+    ProcessTriggeredStops(trades);
+    return trades;
+}
+
+Result<Trades> Orderbook::ExecuteOrder(OrderIndex index){
+    return pool_.Hot(index).side_ == Side::Buy ? ExecuteOrder<Side::Buy>(index) : ExecuteOrder<Side::Sell>(index);
+}
+
+template <Side S>
+Result<Trades> Orderbook::ExecuteOrder(OrderIndex index){
+    OrderHot& order = pool_.Hot(index);
+    OrderCold& cold = pool_.Cold(index);
+    if (order.type_ == OrderType::GoodForDay && cold.expiry_ == 0){
+        cold.expiry_ = NextSessionClose(clock_());
+    }
+    // a GTT order without an expiry, or one that has already expired, is rejected.
+    if (order.type_ == OrderType::GoodTillTime && cold.expiry_ <= clock_()){
+        RejectOrder(index);
+        return std::unexpected(OrderError::Expired);
+    }
+
+    // immediate-or-cancel style orders have nothing to execute against while the auction is calling.
+    bool isImmediate = order.type_ == OrderType::Market || order.type_ == OrderType::FillAndKill || order.type_ == OrderType::FillOrKill;
+    if (phase_ == TradingPhase::Auction && isImmediate){
+        RejectOrder(index);
+        return std::unexpected(OrderError::AuctionCall);
+    }
+
+    // an order that never rests has nothing to hide, a display size on it would only stall the sweep once the slice is gone.
+    if (order.type_ == OrderType::Market || order.type_ == OrderType::FillOrKill){
+        order.remaining_ += order.hidden_;
+        order.hidden_ = 0;
+    }
+
+    // market orders walk the other side with no price limit. whatever is left over is simply dropped (cancelled).
+    if (order.type_ == OrderType::Market){
+        Trades trades = SweepOrder<S>(index, SideTraits<S>::MarketLimit);
+        FreeOrder(index);
+        return trades;
+    }
+
+    // fill-or-kill is checked against the level totals first, so a kill leaves the book completely untouched.
+    if (order.type_ == OrderType::FillOrKill){
+        Trades trades;
+        if (CanFullyFill<S>(order.price_, order.remaining_, order.owner_, order.selfTradePrevention_)){
+            trades = SweepOrder<S>(index, order.price_);
+        }
+        FreeOrder(index);
+        return trades;
+    }
+
+    if (order.type_ == OrderType::FillAndKill && !CanMatch<S>(order.price_)){
+        FreeOrder(index);
+        return { };
+    }
+    
+    RestOrder<S>(index);
+
+    // during a call orders just accumulate, matching happens all at once in UncrossAuction().
+    if (phase_ == TradingPhase::Auction){
+        return { };
+    }
+
+    Trades trades = MatchOrders(index);
+    if (!trades.empty()){
+        // the order that was already resting sets the price, which is the opposite side of the one we just added.
+        if constexpr (S == Side::Buy){
+            lastTradePrice_ = trades.back().GetAskTrade().price_;
+        }else{
+            lastTradePrice_ = trades.back().GetBidTrade().price_;
+        }
+        lastTradeQuantity_ = trades.back().GetBidTrade().quantity_;
+    }
+    return trades;
+}
+
+template <Side S>
+void Orderbook::RestOrder(OrderIndex index){
+    const OrderHot& order = pool_.Hot(index);
+    OrderCold& cold = pool_.Cold(index);
+    // LevelsFor<S>() is bids_ (our buy-side storage) or asks_ (our sell-side storage), picked at compile time.
+    // this line causes INSERTION, where the price of the order is used as the key, and simultaneously gives an "orders" alias which is the FIFO of orders at the specific price level.
+    auto& orders = LevelsFor<S>()[order.price_];
+    // the order is linked in at the back (FIFO). its slot index is all we need for O(1) removal later.
+    pool_.PushBack(orders, index);
+
+    // general bookkeeping in the orders_ OrderBook.
+    if (cold.expiry_ != 0){
+        cold.expiryTimer_ = expiryWheel_.Arm(cold.expiry_, order.orderId_);
+    }
+    orders_.insert({order.orderId_, index});
+    OnOrderAdded(index);
+}
+
+void Orderbook::LiftOrder(OrderIndex index){
+    const OrderHot& order = pool_.Hot(index);
+    OnOrderCancelled(index);
+
+    // a sell order comes out of asks_, a buy order out of bids_. the side is picked once, here.
+    if (order.side_ == Side::Sell){
+        RemoveFromLevel<Side::Sell>(order.price_, index);
+    }else{
+        RemoveFromLevel<Side::Buy>(order.price_, index);
+    }
+    DetachOrder(index);
+}
+
+void Orderbook::ResetOrder(OrderIndex index, Side side, Price price, Quantity quantity){
+    OrderHot& order = pool_.Hot(index);
+    OrderCold& cold = pool_.Cold(index);
+    // the iceberg split is redone on the new quantity, the same way Order::SetDisplayQuantity() does it:
+    // a display size that no longer hides anything means it isn't an iceberg any more.
+    bool iceberg = cold.display_ != 0 && cold.display_ < quantity;
+    order.side_ = side;
+    order.price_ = price;
+    order.remaining_ = iceberg ? cold.display_ : quantity;
+    order.hidden_ = quantity - order.remaining_;
+    cold.display_ = iceberg ? cold.display_ : 0;
+    cold.initial_ = quantity;
+}
+
+Result<void> Orderbook::CancelOrder(OrderId orderId){
+    PublishOnReturn publish{ *this };
+    if (stops_.contains(orderId)){
+        CancelStopOrder(orderId);
+        return { };
+    }
+    auto entry = orders_.find(orderId);
+    if (entry == orders_.end()){
+        return std::unexpected(OrderError::UnknownOrder);
+    }
+    // copy the index out first, LiftOrder() removes the entry it lives in.
+    const OrderIndex index = entry->second;
+    LiftOrder(index);
+    FreeOrder(index);
+    return { };
+}
+
+template <Side S>
+void Orderbook::RemoveFromLevel(Price price, OrderIndex index){
+    auto& levels = LevelsFor<S>();
+    auto level = levels.find(price);
+    ORDERBOOK_ASSERT(level != levels.end());
+    pool_.Unlink(level->second, index);
+    // if the level is empty after, we need to remove the price altogether from it (memory cleanup).
+    if (level->second.Empty()){
+        levels.erase(level);
+    }
+}
+
+Result<Trades> Orderbook::MatchOrder(OrderModify order){
+    PublishOnReturn publish{ *this };
+    ExpireOrders();
+    auto entry = orders_.find(order.GetOrderId());
+    if (entry == orders_.end()){
+        return std::unexpected(OrderError::UnknownOrder);
+    }
+    if (order.GetQuantity() == 0){
+        // a modify down to nothing is a cancel.
+        CancelOrder(order.GetOrderId());
+        return Trades{ };
+    }
+    const OrderIndex index = entry->second;
+    const OrderHot& existing = pool_.Hot(index);
+
+    // market makers resizing a quote down is the common case, and it shouldn't cost them their place in the queue.
+    Quantity open = existing.remaining_ + existing.hidden_;
+    if (order.GetSide() == existing.side_ && order.GetPrice() == existing.price_ && order.GetQuantity() <= open){
+        ReduceOrder(index, open - order.GetQuantity());
+        return Trades{ };
+    }
+
+    // take it off its level exactly like a cancel, but keep the slot, and put it back through matching as a fresh order.
+    LiftOrder(index);
+    ResetOrder(index, order.GetSide(), order.GetPrice(), order.GetQuantity());
+
+    Result<Trades> trades = ExecuteOrder(index);
+    if (trades){
+        ProcessTriggeredStops(*trades);
+    }
+    return trades;
+}
+
+template <Side S>
+std::size_t Orderbook::CancelLevels(const MassCancelFilter& filter){
+    auto& levels = LevelsFor<S>();
+    auto& data = LevelDataFor<S>();
+    // levels are stored best first, so the band starts at its best price (the highest bid, the lowest ask).
+    std::optional<Price> nearBound = S == Side::Buy ? filter.maxPrice_ : filter.minPrice_;
+    std::optional<Price> farBound = S == Side::Buy ? filter.minPrice_ : filter.maxPrice_;
+    auto level = nearBound ? levels.lower_bound(*nearBound) : levels.begin();
+    auto last = farBound ? levels.upper_bound(*farBound) : levels.end();
+
+    std::size_t cancelled = 0;
+    while (level != last){
+        auto& [price, queue] = *level;
+        LevelData removed;
+        for (OrderIndex index = queue.head_; index != NoOrder; ){
+            const OrderHot& order = pool_.Hot(index);
+            OrderIndex next = order.next_;
+            if (!filter.owner_ || order.owner_ == *filter.owner_){
+                if (filter.owner_){
+                    pool_.Unlink(queue, index); // without an owner filter the whole level goes, so there is nothing to unlink from.
+                }
+                removed.quantity_ += order.remaining_;
+                removed.hiddenQuantity_ += order.hidden_;
+                removed.count_++;
+                UpdateOwnerQuantity(S, price, order.owner_, -(std::int64_t{ order.remaining_ } + order.hidden_));
+                AccountFor(order.owner_).openOrders_--;
+                UpdateOpenRisk(order, -(std::int64_t{ order.remaining_ } + order.hidden_));
+                EraseOrder(index);
+            }
+            index = next;
+        }
+        cancelled += removed.count_;
+
+        if (removed.count_ == 0){
+            ++level;
+            continue;
+        }
+        levelVersion_++;
+        Price levelPrice = price;
+        if (!filter.owner_ || queue.Empty()){
+            data.erase(price);
+            level = levels.erase(level);
+        }else{
+            LevelData& totals = data.at(price);
+            totals.quantity_ -= removed.quantity_;
+            totals.hiddenQuantity_ -= removed.hiddenQuantity_;
+            totals.count_ -= removed.count_;
+            totals.queue_.reset(); // cheaper to rebuild on the next query than to take each order out.
+            ++level;
+        }
+        UpdateDepth<S>(levelPrice, -std::int64_t{ removed.quantity_ });
+    }
+    return cancelled;
+}
+
+template <typename Stops>
+std::size_t Orderbook::CancelStops(Stops& stops, const MassCancelFilter& filter){
+    std::size_t cancelled = 0;
+    for (auto level = stops.begin(); level != stops.end(); ){
+        auto& [stopPrice, queue] = *level;
+        bool inBand = (!filter.minPrice_ || stopPrice >= *filter.minPrice_) && (!filter.maxPrice_ || stopPrice <= *filter.maxPrice_);
+        for (OrderIndex index = inBand ? queue.head_ : NoOrder; index != NoOrder; ){
+            const OrderHot& order = pool_.Hot(index);
+            OrderIndex next = order.next_;
+            if (!filter.owner_ || order.owner_ == *filter.owner_){
+                pool_.Unlink(queue, index);
+                stops_.erase(order.orderId_);
+                FreeOrder(index);
+                cancelled++;
+            }
+            index = next;
+        }
+        level = queue.Empty() ? stops.erase(level) : std::next(level);
+    }
+    return cancelled;
+}
+
+std::size_t Orderbook::CancelOrders(const MassCancelFilter& filter){
+    PublishOnReturn publish{ *this };
+    ExpireOrders();
+    if (filter.minPrice_ && filter.maxPrice_ && *filter.minPrice_ > *filter.maxPrice_){
+        return 0;
+    }
+
+    // the whole book: nothing needs to be unlinked, erased or freed one at a time.
+    if (!filter.side_ && !filter.minPrice_ && !filter.maxPrice_ && !filter.owner_ && filter.includeStops_){
+        std::size_t cancelled = Size();
+        for (const auto& [_, index] : orders_){
+            RecordFinished(index);
+        }
+        for (const auto& [_, index] : stops_){
+            RecordFinished(index);
+        }
+        for (AccountRisk& account : accounts_){
+            account = AccountRisk{ .position_ = account.position_ };
+        }
+        bids_.clear();
+        asks_.clear();
+        bidData_.clear();
+        askData_.clear();
+        bidOwnerQuantity_.clear();
+        askOwnerQuantity_.clear();
+        bidDepth_.Clear();
+        askDepth_.Clear();
+        orders_.clear();
+        buyStops_.clear();
+        sellStops_.clear();
+        stops_.clear();
+        quotes_.clear();
+        expiryWheel_.Clear();
+        pool_.Clear();
+        levelVersion_++;
+        return cancelled;
+    }
+
+    std::size_t cancelled = 0;
+    if (filter.side_ != Side::Sell){
+        cancelled += CancelLevels<Side::Buy>(filter);
+        cancelled += filter.includeStops_ ? CancelStops(buyStops_, filter) : 0;
+    }
+    if (filter.side_ != Side::Buy){
+        cancelled += CancelLevels<Side::Sell>(filter);
+        cancelled += filter.includeStops_ ? CancelStops(sellStops_, filter) : 0;
+    }
+    return cancelled;
+}
+
+Result<void> Orderbook::CheckQuote(const Quote& quote) const{
+    if (quote.owner_ == 0){
+        return std::unexpected(OrderError::QuoteWithoutAccount);
+    }
+    bool bothSides = quote.bid_.quantity_ != 0 && quote.ask_.quantity_ != 0;
+    if (bothSides && quote.bid_.price_ >= quote.ask_.price_){
+        return std::unexpected(OrderError::CrossedQuote);
+    }
+    if (bothSides && quote.bid_.orderId_ == quote.ask_.orderId_){
+        return std::unexpected(OrderError::DuplicateOrderId);
+    }
+
+    // every quoted side needs an id that is free (or is already that leg's), in case its live leg has gone by the time it is applied.
+    auto current = quotes_.find(quote.owner_);
+    QuoteOrders live = current != quotes_.end() ? current->second : QuoteOrders{ };
+    for (auto [side, liveId] : { std::pair{ &quote.bid_, live.bid_ }, std::pair{ &quote.ask_, live.ask_ } }){
+        if (side->quantity_ == 0 || side->orderId_ == liveId){
+            continue;
+        }
+        if (orders_.contains(side->orderId_) || stops_.contains(side->orderId_)){
+            return std::unexpected(OrderError::DuplicateOrderId);
+        }
+    }
+    return { };
+}
+
+template <Side S>
+OrderIndex Orderbook::PlaceQuoteSide(const Quote& quote, const QuoteSide& side, OrderId& live){
+    auto entry = live != 0 ? orders_.find(live) : orders_.end();
+    // a leg that has been modified onto the other side isn't this side's leg any more.
+    if (entry == orders_.end() || pool_.Hot(entry->second).side_ != S){
+        live = 0;
+        if (side.quantity_ == 0){
+            return NoOrder;
+        }
+        Order order(OrderType::GoodTillCancel, S, side.price_, side.quantity_, side.orderId_);
+        order.SetOwner(quote.owner_, quote.selfTradePrevention_);
+        OrderIndex index = pool_.Allocate(order);
+        RestOrder<S>(index);
+        live = side.orderId_;
+        return index;
+    }
+
+    OrderIndex index = entry->second;
+    if (side.quantity_ == 0){
+        LiftOrder(index);
+        FreeOrder(index);
+        live = 0;
+        return NoOrder;
+    }
+
+    OrderHot& order = pool_.Hot(index);
+    order.selfTradePrevention_ = quote.selfTradePrevention_;
+    Quantity open = order.remaining_ + order.hidden_;
+    if (order.price_ == side.price_ && side.quantity_ <= open){
+        if (side.quantity_ < open){
+            ReduceOrder(index, open - side.quantity_);
+        }
+        return index;
+    }
+    LiftOrder(index);
+    ResetOrder(index, S, side.price_, side.quantity_);
+    RestOrder<S>(index);
+    return index;
+}
+
+Result<QuoteAck> Orderbook::UpdateQuote(const Quote& quote){
+    PublishOnReturn publish{ *this };
+    ExpireOrders();
+    if (Result<void> valid = CheckQuote(quote); !valid){
+        return std::unexpected(valid.error());
+    }
+
+    QuoteOrders& live = quotes_[quote.owner_];
+    OrderIndex bid = PlaceQuoteSide<Side::Buy>(quote, quote.bid_, live.bid_);
+    OrderIndex ask = PlaceQuoteSide<Side::Sell>(quote, quote.ask_, live.ask_);
+    QuoteAck ack{ live.bid_, live.ask_, Trades{ } };
+    if (live.bid_ == 0 && live.ask_ == 0){
+        quotes_.erase(quote.owner_);
+    }
+
+    // the book was uncrossed before and bid < ask, so at most one leg can be crossing now. that leg is the incoming
+    // order as far as MatchOrders() (and self-trade prevention) is concerned.
+    if (phase_ == TradingPhase::Continuous){
+        bool bidCrosses = bid != NoOrder && CanMatch<Side::Buy>(pool_.Hot(bid).price_);
+        bool askCrosses = ask != NoOrder && CanMatch<Side::Sell>(pool_.Hot(ask).price_);
+        if (bidCrosses || askCrosses){
+            ack.trades_ = MatchOrders(bidCrosses ? bid : ask);
+            if (!ack.trades_.empty()){
+                lastTradePrice_ = bidCrosses ? ack.trades_.back().GetAskTrade().price_ : ack.trades_.back().GetBidTrade().price_;
+                lastTradeQuantity_ = ack.trades_.back().GetBidTrade().quantity_;
+            }
+        }
+    }
+    ProcessTriggeredStops(ack.trades_);
+    return ack;
+}
+
+OrderBookLevelInfo Orderbook::GetOrderInfos() const{
+    // alias for a LevelInfo vector, and we allocate memory in each LevelInfos (orders_ is conservative, we can use asks_ and bids_ if we really wanted to).
+    LevelInfos askinfos, bidinfos;
+    bidinfos.reserve(bids_.size());
+    askinfos.reserve(asks_.size());
+
+    // the per-level totals in bidData_/askData_ already hold the sum of every order's remaining quantity at a price,
+    // so we only walk the levels (in price order), never the orders inside them.
+    for (const auto& [price, _] : bids_)
+        bidinfos.push_back(LevelInfo{ price, bidData_.at(price).quantity_ });
+    
+    for (const auto& [price, _] : asks_)
+        askinfos.push_back(LevelInfo{ price, askData_.at(price).quantity_ });
+    // in the end, bidinfos and askinfos is a vector of the "LevelInfo" object, which stores price-totalquantity pair(s). 
+    // helps us find the liquidity of shares at certain prices, using asks/bids.
+    return OrderBookLevelInfo(askinfos, bidinfos);
+}
+
+std::uint64_t Orderbook::Checksum() const{
+    // FNV-1a over the fields, one 64-bit word at a time.
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash](std::uint64_t value){
+        hash = (hash ^ value) * 0x100000001b3ull;
+    };
+    auto mixQueue = [&](Price price, const LevelQueue& level){
+        mix(static_cast<std::uint64_t>(static_cast<std::int64_t>(price)));
+        for (OrderIndex index = level.head_; index != NoOrder; index = pool_.Hot(index).next_){
+            const OrderHot& order = pool_.Hot(index);
+            const OrderCold& cold = pool_.Cold(index);
+            mix(order.orderId_);
+            mix((std::uint64_t{ order.remaining_ } << 32) | order.hidden_);
+            mix((std::uint64_t{ order.owner_ } << 16) | (static_cast<std::uint64_t>(order.type_) << 8) | static_cast<std::uint64_t>(order.selfTradePrevention_));
+            mix(static_cast<std::uint64_t>(cold.expiry_));
+            mix((std::uint64_t{ cold.initial_ } << 32) | cold.display_);
+        }
+    };
+
+    for (const auto& [price, level] : bids_){ mixQueue(price, level); }
+    mix(1);
+    for (const auto& [price, level] : asks_){ mixQueue(price, level); }
+    mix(2);
+    for (const auto& [price, level] : buyStops_){ mixQueue(price, level); }
+    mix(3);
+    for (const auto& [price, level] : sellStops_){ mixQueue(price, level); }
+    mix(4);
+    for (const AccountRisk& account : accounts_){
+        mix(account.openOrders_);
+        mix(static_cast<std::uint64_t>(account.position_));
+        mix(account.openBuyQuantity_);
+        mix(account.openSellQuantity_);
+        mix(account.openNotional_);
+    }
+    mix(static_cast<std::uint64_t>(phase_));
+    mix(lastTradePrice_ ? static_cast<std::uint64_t>(static_cast<std::int64_t>(*lastTradePrice_)) : ~std::uint64_t{ 0 });
+    mix(tape_.Next());
+    return hash;
+}
@@ -0,0 +1,1765 @@
+#pragma once
+
+// The matching engine: orders, trades and the Orderbook itself. Nothing in here knows about HTTP,
+// so it can be linked into the server, the benchmark, or anything else that wants to drive a book directly.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <expected>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Invariant checks inside the engine. The engine library is built without exceptions (see ORDERBOOK_EXCEPTIONS), so a
+// broken invariant can't be thrown: the assert handler gets a chance to log it, then the process aborts.
+// on in debug builds, compiled out of optimized ones unless ORDERBOOK_ENABLE_ASSERTS is defined (ORDERBOOK_ASSERTS in CMake).
+using AssertHandler = void (*)(const char* expression, const char* file, int line);
+void SetAssertHandler(AssertHandler handler);
+[[noreturn]] void AssertFailed(const char* expression, const char* file, int line);
+
+#if defined(ORDERBOOK_ENABLE_ASSERTS) || !defined(NDEBUG)
+    #define ORDERBOOK_ASSERT(condition) ((condition) ? static_cast<void>(0) : AssertFailed(#condition, __FILE__, __LINE__))
+#else
+    #define ORDERBOOK_ASSERT(condition) static_cast<void>(sizeof(!(condition)))
+#endif
+
+// "Order"s will have a Time Enforcement option.
+// Market orders carry no limit price: they sweep the opposite side and never rest in the book.
+// FillOrKill orders either execute in full immediately or do nothing at all.
+// GoodForDay orders expire at the book's session close, GoodTillTime orders at their own expiry timestamp.
+// Stop / StopLimit orders wait in the book's trigger index until the last trade reaches their stop price,
+// then enter matching as a Market / GoodTillCancel order respectively.
+enum class OrderType : std::uint8_t{
+    GoodTillCancel,
+    FillAndKill,
+    Market,
+    FillOrKill,
+    GoodForDay,
+    GoodTillTime,
+    Stop,
+    StopLimit
+};
+
+// "Order"s will have a Side. Side::Buy or Side::Sell
+enum class Side : std::uint8_t{
+    Buy,
+    Sell
+};
+
+// What happens when two orders from the same owner would trade with each other. The newest order's mode is used.
+enum class SelfTradePrevention : std::uint8_t{
+    CancelNewest,
+    CancelOldest,
+    CancelBoth,
+    Decrement // shrink both by the overlapping quantity without printing a trade
+};
+
+// alias types
+using Price = std::int32_t; // price can be negative
+using Quantity = std::uint32_t;
+using OrderId = std::uint64_t;
+using AccountId = std::uint32_t; // owner of an order, 0 = anonymous (never self-trade checked)
+using Timestamp = std::int64_t; // milliseconds since the unix epoch
+
+// Books read time through an injectable clock instead of calling system_clock directly,
+// so a replay can drive expiry from recorded timestamps and get exactly the same result.
+using EngineClock = std::function<Timestamp()>;
+
+inline Timestamp SystemClockNow(){
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// in cpp we denote "member varaibles" (i.e not parameters) with a "_".
+
+struct LevelInfo{
+    Price price_;
+    Quantity quantity_;
+};
+
+// LevelInfos stores all the Quantity's at a certain price (level).
+using LevelInfos = std::vector<LevelInfo>;
+
+// OrderBookLevelInfo stores the vectors for asks and bids for all prices.
+class OrderBookLevelInfo{
+    // we need seperate vectors for bids and asks
+    public:
+        OrderBookLevelInfo(const LevelInfos& asks, const LevelInfos& bids):
+        // constructor instantiation
+        bids_(bids),
+        asks_(asks) {}
+
+        const LevelInfos& GetBids() const { return bids_; }
+        const LevelInfos& GetAsks() const { return asks_; }
+    
+    private:
+        LevelInfos bids_;
+        LevelInfos asks_;
+};
+
+// What is added to the order book? Objets that have the order type, key, side, price, quantity, and bool(s) for filled or not
+// Order stores instances of an order (with all needed properties).
+// This is the order as a client submits it. The book copies it into its own compact storage (see OrderPool)
+// and reports back what happened to it in AddOrder, so the caller can read the fills off the same object.
+class Order {
+    // A PUBLIC constructor can initialize private fields.
+    public:
+        Order(OrderType orderType, Side side, Price price, Quantity quantity, OrderId orderId): 
+            orderType_(orderType),
+            orderId_(orderId),
+            price_(price),
+            side_(side),
+            initialQuantity_(quantity),
+            remainingQuantity_(quantity) {}
+
+        // const in the function sig. means it will NOT alter the members (getts and setters, bools).
+        OrderId GetOrderId() const { return orderId_; }
+        Side GetSide() const { return side_; }
+        Price GetPrice() const { return price_; }
+        OrderType GetOrderType() const { return orderType_; }
+        Quantity GetInitialQuantity() const { return initialQuantity_; }
+        Quantity GetRemainingQuantity() const { return remainingQuantity_; }
+        Quantity FilledQuantity() const { return GetInitialQuantity() - GetRemainingQuantity() - GetHiddenQuantity();}
+        bool IsFilled() const { return GetRemainingQuantity() == 0 && GetHiddenQuantity() == 0;}
+
+        // Iceberg (reserve) orders: only displayQuantity_ is ever visible/matchable at once (remainingQuantity_),
+        // the rest waits in hiddenQuantity_ until the displayed slice has traded away.
+        bool IsIceberg() const { return displayQuantity_ != 0; }
+        Quantity GetDisplayQuantity() const { return displayQuantity_; }
+        Quantity GetHiddenQuantity() const { return hiddenQuantity_; }
+
+        void SetDisplayQuantity(Quantity displayQuantity){
+            if (displayQuantity == 0 || displayQuantity >= remainingQuantity_ + hiddenQuantity_){
+                return; // showing everything anyway, so this isn't an iceberg.
+            }
+            hiddenQuantity_ += remainingQuantity_ - displayQuantity;
+            remainingQuantity_ = displayQuantity;
+            displayQuantity_ = displayQuantity;
+        }
+
+        // only GoodForDay / GoodTillTime orders expire. 0 means "never".
+        Timestamp GetExpiry() const { return expiry_; }
+        void SetExpiry(Timestamp expiry) { expiry_ = expiry; }
+
+        // only used by Stop / StopLimit orders, see Orderbook's trigger index.
+        Price GetStopPrice() const { return stopPrice_; }
+        void SetStopPrice(Price stopPrice) { stopPrice_ = stopPrice; }
+        bool IsStopOrder() const { return orderType_ == OrderType::Stop || orderType_ == OrderType::StopLimit; }
+
+        AccountId GetOwner() const { return owner_; }
+        SelfTradePrevention GetSelfTradePrevention() const { return selfTradePrevention_; }
+        void SetOwner(AccountId owner, SelfTradePrevention selfTradePrevention){
+            owner_ = owner;
+            selfTradePrevention_ = selfTradePrevention;
+        }
+
+        // written by the book at the end of AddOrder. initial can shrink too (self-trade prevention's Decrement mode).
+        void SetQuantities(Quantity initial, Quantity remaining, Quantity hidden){
+            initialQuantity_ = initial;
+            remainingQuantity_ = remaining;
+            hiddenQuantity_ = hidden;
+        }
+
+        // the reason we need this private section here is because without it, we declare the variables in our public: modifier, but never assign them a type.
+    private:
+        OrderType orderType_;
+        OrderId orderId_;
+        Price price_;
+        Side side_;
+        Quantity initialQuantity_;
+        Quantity remainingQuantity_;
+        Timestamp expiry_ { 0 };
+        Price stopPrice_ { 0 };
+        Quantity displayQuantity_ { 0 };
+        Quantity hiddenQuantity_ { 0 };
+        AccountId owner_ { 0 };
+        SelfTradePrevention selfTradePrevention_ { SelfTradePrevention::CancelNewest };
+};
+
+// Orders are handed to the book by pointer. (reference semantics) so the caller can read the outcome off the same object.
+// std::make_shared<type>(); allocates order(s) on the heap, and returns a pointer pointing at it.
+using OrderPointer = std::shared_ptr<Order>;
+
+// Everything that differs between the two sides of a book, resolved at compile time.
+// Each side keeps its levels best price first, so the comparator is also "is this price better than that one".
+// The per-side book logic is written once against these, and commands pick a side once when they enter the book.
+template <Side S>
+struct SideTraits;
+
+template <>
+struct SideTraits<Side::Buy>{
+    using Compare = std::greater<Price>; // highest bid first
+    static constexpr Side Opposite = Side::Sell;
+    static constexpr Price MarketLimit = std::numeric_limits<Price>::max(); // a market buy takes any ask
+
+    // can a buy at "price" trade with an ask resting at "restingPrice"?
+    static constexpr bool Crosses(Price price, Price restingPrice){ return price >= restingPrice; }
+};
+
+template <>
+struct SideTraits<Side::Sell>{
+    using Compare = std::less<Price>; // lowest ask first
+    static constexpr Side Opposite = Side::Buy;
+    static constexpr Price MarketLimit = std::numeric_limits<Price>::min();
+
+    static constexpr bool Crosses(Price price, Price restingPrice){ return price <= restingPrice; }
+};
+
+
+// Common functionality we need to support for orders:
+
+// Add() => we need a new order.
+// Cancel() => we need an existing valid order id.
+// Modify() => we need a way to modify existing orders, and we need to retrieve orders in a well manner.
+
+class OrderModify{
+    public:
+        OrderModify(OrderId orderId, Side side, Price price, Quantity quantity):
+        orderId_(orderId),
+        side_(side),
+        price_(price),
+        quantity_(quantity) {}
+
+    OrderId GetOrderId() const {return orderId_;}
+    Price GetPrice() const {return price_;}
+    Side GetSide() const {return side_;}
+    Quantity GetQuantity() const {return quantity_;}
+
+    // "const" in this function denotes the function does NOT modify any member variables.
+    OrderPointer ToOrderPointer(OrderType type) const {
+    return std::make_shared<Order>(type, GetSide(), GetPrice(), GetQuantity(), GetOrderId());
+}
+
+    private:
+        OrderId orderId_;
+        Side side_;
+        Price price_;
+        Quantity quantity_;
+};
+
+// TradeInfo may exist by itself, but Trade can contain or reference one or more TradeInfo objects.
+struct TradeInfo{
+    OrderId orderid_;
+    Price price_;
+    Quantity quantity_;
+};
+
+// A trade consists of a bid and ask, which will hava TradeInfo objects for eahch.
+class Trade{
+    public:
+
+        Trade(const TradeInfo& bidTrade, const TradeInfo& askTrade):
+        bidTrade_ { bidTrade},
+        askTrade_ { askTrade} {}
+
+        const TradeInfo& GetBidTrade(){return bidTrade_;}
+        const TradeInfo& GetAskTrade(){return askTrade_;}
+
+    private:
+        TradeInfo bidTrade_;
+        TradeInfo askTrade_;
+};
+
+
+// vector of trade object, representing bids and asks
+using Trades = std::vector<Trade>;
+
+// Continuous trading matches every order as it arrives. During a call auction (opening/closing) orders only accumulate,
+// and everything that crosses is executed at a single price when the auction is uncrossed.
+enum class TradingPhase{
+    Continuous,
+    Auction
+};
+
+// Pre-trade risk limits, applied per book. 0 means "no limit".
+// the account-level limits (open orders, position, exposure) only apply to orders that carry an account id.
+struct RiskLimits{
+    Quantity maxOrderQuantity_ { 1'000'000 };
+    std::uint64_t maxOrderNotional_ { 0 }; // |price| * quantity of a single order
+    std::uint32_t maxOpenOrders_ { 0 };    // resting orders per account
+    std::uint64_t maxPosition_ { 0 };      // |net position| if every open order on that side (and this one) filled
+    std::uint64_t maxExposure_ { 0 };      // total |price| * quantity of an account's resting orders, including this one
+};
+
+enum class RiskReject{
+    None,
+    OrderQuantity,
+    OrderNotional,
+    OpenOrders,
+    Position,
+    Exposure
+};
+
+inline const char* RiskRejectName(RiskReject reject){
+    switch (reject){
+        case RiskReject::OrderQuantity: return "order quantity limit exceeded";
+        case RiskReject::OrderNotional: return "order notional limit exceeded";
+        case RiskReject::OpenOrders: return "open order limit exceeded";
+        case RiskReject::Position: return "position limit exceeded";
+        case RiskReject::Exposure: return "exposure limit exceeded";
+        default: return "accepted";
+    }
+}
+
+// Why the book refused a command. returned in a Result rather than thrown, so the matching path has no unwinding to do.
+// an order that is accepted but can't trade (a killed FOK, an FAK with nothing to hit) is not an error, it just has no trades.
+enum class OrderError : std::uint8_t{
+    DuplicateOrderId,
+    UnknownOrder,
+    Expired,
+    AuctionCall,
+    NotInAuction,
+    QuoteWithoutAccount,
+    CrossedQuote
+};
+
+inline const char* OrderErrorName(OrderError error){
+    switch (error){
+        case OrderError::DuplicateOrderId: return "order id already in use";
+        case OrderError::UnknownOrder: return "order not found";
+        case OrderError::Expired: return "order has already expired";
+        case OrderError::AuctionCall: return "immediate orders are not accepted during an auction call";
+        case OrderError::NotInAuction: return "book is not in an auction";
+        case OrderError::QuoteWithoutAccount: return "quotes need an account";
+        case OrderError::CrossedQuote: return "quote bid must be below its ask";
+        default: return "unknown error";
+    }
+}
+
+template <typename T>
+using Result = std::expected<T, OrderError>;
+
+// running per-account counters in one book, kept up to date as orders rest, fill and cancel.
+struct AccountRisk{
+    std::uint32_t openOrders_ { 0 };
+    std::int64_t position_ { 0 }; // bought minus sold
+    std::uint64_t openBuyQuantity_ { 0 };
+    std::uint64_t openSellQuantity_ { 0 };
+    std::uint64_t openNotional_ { 0 };
+};
+
+// Which orders a mass cancel removes. every filter that is set has to match, so an empty filter clears the whole book.
+// untriggered stops are matched on their side, owner and stop price.
+struct MassCancelFilter{
+    std::optional<Side> side_;
+    std::optional<Price> minPrice_;   // inclusive price band
+    std::optional<Price> maxPrice_;
+    std::optional<AccountId> owner_;
+    bool includeStops_ { true };
+};
+
+// One side of a two-sided quote. a quantity of 0 pulls that side.
+// orderId_ is only used when the account has no live order on that side yet, otherwise the live one is updated in place.
+struct QuoteSide{
+    OrderId orderId_ { 0 };
+    Price price_ { 0 };
+    Quantity quantity_ { 0 };
+};
+
+// A market maker's bid and ask in one book, replaced together. each account has at most one quote per book,
+// and its legs are ordinary GTC orders (they can be cancelled, and they trade like any other order).
+struct Quote{
+    AccountId owner_ { 0 };
+    SelfTradePrevention selfTradePrevention_ { SelfTradePrevention::CancelNewest };
+    QuoteSide bid_;
+    QuoteSide ask_;
+};
+
+// the quote's legs after an update (0 for a side that isn't quoted) and whatever the update traded.
+struct QuoteAck{
+    OrderId bidId_ { 0 };
+    OrderId askId_ { 0 };
+    Trades trades_;
+};
+
+// account ids index straight into a flat array, so they are capped to keep that array small.
+constexpr AccountId MaxAccountId = (1u << 16) - 1;
+
+// what the auction would do if it were uncrossed right now.
+struct AuctionIndicative{
+    std::optional<Price> price_;   // empty while nothing crosses
+    std::uint64_t volume_ { 0 };   // quantity that would execute at price_
+    std::int64_t imbalance_ { 0 }; // bid quantity minus ask quantity available at price_
+};
+
+// What taking "quantity" from one side of the book would cost right now, see Orderbook::EstimateFill().
+// only displayed quantity counts, an iceberg's hidden reserve is nobody else's business.
+struct FillEstimate{
+    std::uint64_t quantity_ { 0 };    // what the book can fill, less than asked for when it runs out
+    std::int64_t notional_ { 0 };     // sum of price x quantity over those fills, so notional_ / quantity_ is the average price
+    std::optional<Price> worstPrice_; // the last price level reached, empty when nothing fills
+};
+
+// Where an order stands, see Orderbook::GetOrderStatus(). a stop that hasn't triggered yet is Pending.
+enum class OrderState : std::uint8_t{
+    Pending,
+    Resting,
+    PartiallyFilled, // resting, with some of it already traded
+    Filled,
+    Cancelled,       // cancelled, expired, or whatever was left of an order that couldn't rest
+    Rejected         // refused on arrival without trading: already expired, or an immediate order during an auction call
+};
+
+inline const char* OrderStateName(OrderState state){
+    switch (state){
+        case OrderState::Pending: return "pending";
+        case OrderState::Resting: return "resting";
+        case OrderState::PartiallyFilled: return "partially_filled";
+        case OrderState::Filled: return "filled";
+        case OrderState::Cancelled: return "cancelled";
+        case OrderState::Rejected: return "rejected";
+        default: return "unknown";
+    }
+}
+
+struct OrderStatus{
+    OrderId orderId_ { 0 };
+    OrderState state_ { OrderState::Pending };
+    Side side_ { Side::Buy };
+    Price price_ { 0 };
+    Quantity initial_ { 0 };
+    Quantity filled_ { 0 };
+    Quantity remaining_ { 0 };           // still open, iceberg reserve included
+    std::uint64_t ordersAhead_ { 0 };    // orders in front of it at its price level (0 unless it is resting)
+    std::uint64_t quantityAhead_ { 0 };  // their displayed quantity
+};
+
+// Best bid/ask and last trade as of the last change to the book, see Orderbook::GetTopOfBook(). a side with no orders
+// has a quantity of 0, and so does the last trade before the first one. quantities are the displayed ones.
+// six 4-byte fields and no padding, so it copies through a SeqLock as three whole words.
+struct TopOfBook{
+    Price bidPrice_ { 0 };
+    Quantity bidQuantity_ { 0 };
+    Price askPrice_ { 0 };
+    Quantity askQuantity_ { 0 };
+    Price lastTradePrice_ { 0 };
+    Quantity lastTradeQuantity_ { 0 };
+
+    bool operator==(const TopOfBook&) const = default;
+};
+static_assert(sizeof(TopOfBook) == 24);
+
+// One execution as the book's trade tape keeps it, see TradeTape. price_ is the execution price (the resting order's, or
+// the uncross price), aggressor_ the side that took liquidity. an uncross has no aggressor as such, there it is the
+// side of the newer of the two orders.
+struct TapeTrade{
+    std::uint64_t sequence_ { 0 }; // per book, from 0, no gaps
+    Timestamp timestamp_ { 0 };    // when the command that caused it ran, in the book's clock
+    OrderId buyOrderId_ { 0 };
+    OrderId sellOrderId_ { 0 };
+    Price price_ { 0 };
+    Quantity quantity_ { 0 };
+    Side aggressor_ { Side::Buy };
+    bool auction_ { false };
+};
+static_assert(sizeof(TapeTrade) == 48);
+
+// One OHLCV bar, see CandleSeries. open/high/low/close are execution prices.
+struct Candle{
+    Timestamp start_ { 0 };         // first millisecond the bar covers
+    Price open_ { 0 };
+    Price high_ { 0 };
+    Price low_ { 0 };
+    Price close_ { 0 };
+    std::uint64_t volume_ { 0 };
+    std::int64_t notional_ { 0 };   // price x quantity summed over the bar, so notional_ / volume_ is its VWAP
+    std::uint32_t trades_ { 0 };
+};
+
+// Single-writer sequence lock. the writer makes the sequence odd, stores the value and makes it even again, and a
+// reader retries until it saw the same even sequence before and after its copy, so readers never block the writer
+// (or each other). the value lives in atomic words, which makes a torn copy something the reader detects and
+// throws away rather than a data race. it sits on its own cache line so readers don't share one with the book's state.
+template <typename T>
+class alignas(64) SeqLock{
+    static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % sizeof(std::uint64_t) == 0);
+    static constexpr std::size_t Words = sizeof(T) / sizeof(std::uint64_t);
+
+    public:
+        // only ever called by one thread at a time (for a book, whoever holds its lock).
+        void Store(const T& value){
+            std::array<std::uint64_t, Words> words;
+            std::memcpy(words.data(), &value, sizeof(T));
+            std::uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+            sequence_.store(sequence + 1, std::memory_order_relaxed);
+            // release, so none of the words can become visible before the odd sequence does.
+            for (std::size_t i = 0; i < Words; i++){
+                words_[i].store(words[i], std::memory_order_release);
+            }
+            sequence_.store(sequence + 2, std::memory_order_release);
+        }
+
+        // safe from any thread.
+        T Load() const{
+            std::array<std::uint64_t, Words> words;
+            std::uint64_t before;
+            do{
+                before = sequence_.load(std::memory_order_acquire);
+                // acquire, so the second sequence load can't be done before the words are read.
+                for (std::size_t i = 0; i < Words; i++){
+                    words[i] = words_[i].load(std::memory_order_acquire);
+                }
+            }while ((before & 1) != 0 || sequence_.load(std::memory_order_relaxed) != before);
+            T value;
+            std::memcpy(static_cast<void*>(&value), words.data(), sizeof(T));
+            return value;
+        }
+
+    private:
+        std::atomic<std::uint64_t> sequence_ { 0 };
+        std::array<std::atomic<std::uint64_t>, Words> words_{ };
+};
+
+// The last Capacity executions of a book, oldest overwritten first, preallocated so appending never allocates.
+// one writer (whoever holds the book's lock) appends, any number of readers copy ranges out without taking it. like
+// SeqLock, entries live in atomic words: a reader copies what it wants, then drops whatever the writer may have started
+// overwriting meanwhile (anything a whole lap behind the sequence it finds afterwards).
+class TradeTape{
+    static constexpr std::size_t Words = sizeof(TapeTrade) / sizeof(std::uint64_t);
+    using Slot = std::array<std::atomic<std::uint64_t>, Words>;
+
+    public:
+        static constexpr std::size_t Capacity = 1 << 14;
+
+        TradeTape(): slots_(std::make_unique<Slot[]>(Capacity)) {}
+
+        // the sequence the next trade will get, so also how many there have been.
+        std::uint64_t Next() const { return next_.load(std::memory_order_acquire); }
+
+        // writer only. the trade's sequence_ is filled in here.
+        void Append(TapeTrade trade){
+            std::uint64_t sequence = next_.load(std::memory_order_relaxed);
+            trade.sequence_ = sequence;
+            std::array<std::uint64_t, Words> words;
+            std::memcpy(words.data(), &trade, sizeof(TapeTrade));
+            Slot& slot = slots_[sequence & (Capacity - 1)];
+            for (std::size_t i = 0; i < Words; i++){
+                slot[i].store(words[i], std::memory_order_release);
+            }
+            next_.store(sequence + 1, std::memory_order_release);
+        }
+
+        // up to "limit" trades from sequence "from" on, oldest first. the tape only goes back Capacity trades, so the
+        // first one returned can be later than "from".
+        std::vector<TapeTrade> Since(std::uint64_t from, std::size_t limit) const{
+            std::uint64_t end = Next();
+            std::uint64_t begin = std::max(from, Oldest(end));
+            end = std::min(end, begin + std::min<std::uint64_t>(limit, Capacity));
+            std::vector<TapeTrade> trades;
+            trades.reserve(begin < end ? end - begin : 0);
+            for (std::uint64_t sequence = begin; sequence < end; sequence++){
+                trades.push_back(Read(sequence));
+            }
+            // sequence s shares its slot with s + Capacity, which the writer may have been storing once Next() reached it.
+            std::uint64_t intact = next_.load(std::memory_order_relaxed) + 1;
+            if (intact > begin + Capacity){
+                trades.erase(trades.begin(), trades.begin() + static_cast<std::ptrdiff_t>(std::min<std::uint64_t>(intact - Capacity - begin, trades.size())));
+            }
+            return trades;
+        }
+
+        // the sequence of the first trade at or after "time" (Next() if there is none), by binary search: the book's
+        // clock doesn't go backwards, so timestamps along the tape are sorted. like Since(), a slot the writer has started
+        // reusing is detected rather than read: the search starts again over what the tape holds by then.
+        std::uint64_t Find(Timestamp time) const{
+            for (;;){
+                std::uint64_t end = Next();
+                std::uint64_t low = Oldest(end);
+                std::uint64_t high = end;
+                bool overwritten = false;
+                while (low < high){
+                    std::uint64_t middle = low + (high - low) / 2;
+                    const Slot& slot = slots_[middle & (Capacity - 1)];
+                    Timestamp timestamp = static_cast<Timestamp>(slot[TimestampWord].load(std::memory_order_acquire));
+                    // Append() stores the sequence word before the timestamp, so a timestamp from a newer trade in this
+                    // slot comes with that trade's sequence.
+                    if (slot[SequenceWord].load(std::memory_order_acquire) != middle){
+                        overwritten = true;
+                        break;
+                    }
+                    if (timestamp < time){
+                        low = middle + 1;
+                    }else{
+                        high = middle;
+                    }
+                }
+                if (!overwritten){
+                    return low;
+                }
+            }
+        }
+
+    private:
+        static constexpr std::size_t SequenceWord = offsetof(TapeTrade, sequence_) / sizeof(std::uint64_t);
+        static constexpr std::size_t TimestampWord = offsetof(TapeTrade, timestamp_) / sizeof(std::uint64_t);
+        static_assert(SequenceWord < TimestampWord, "Append() has to store the sequence before the timestamp");
+
+        static std::uint64_t Oldest(std::uint64_t end){ return end > Capacity ? end - Capacity : 0; }
+
+        TapeTrade Read(std::uint64_t sequence) const{
+            const Slot& slot = slots_[sequence & (Capacity - 1)];
+            std::array<std::uint64_t, Words> words;
+            for (std::size_t i = 0; i < Words; i++){
+                words[i] = slot[i].load(std::memory_order_acquire);
+            }
+            TapeTrade trade;
+            std::memcpy(static_cast<void*>(&trade), words.data(), sizeof(TapeTrade));
+            return trade;
+        }
+
+        std::unique_ptr<Slot[]> slots_;
+        alignas(64) std::atomic<std::uint64_t> next_ { 0 };
+};
+
+// Bars of one interval for one book, built as fills happen: a fill either lands in the current bar or opens the next one,
+// so it is O(1) however long the history. the last Capacity bars are kept in a ring, which is only allocated once the
+// first fill arrives. intervals with no trades don't get a bar.
+class CandleSeries{
+    public:
+        static constexpr std::size_t Capacity = 1024;
+
+        explicit CandleSeries(Timestamp interval): interval_(interval) {}
+
+        Timestamp Interval() const { return interval_; }
+
+        void Add(Timestamp time, Price price, Quantity quantity){
+            Timestamp start = time - time % interval_;
+            // a clock that steps back a little is folded into the current bar rather than reopening an old one.
+            if (count_ == 0 || start > Current().start_){
+                if (bars_.empty()){
+                    bars_.resize(Capacity);
+                }
+                count_++;
+                Current() = Candle{ start, price, price, price, price };
+            }
+            Candle& bar = Current();
+            bar.high_ = std::max(bar.high_, price);
+            bar.low_ = std::min(bar.low_, price);
+            bar.close_ = price;
+            bar.volume_ += quantity;
+            bar.notional_ += std::int64_t{ price } * quantity;
+            bar.trades_++;
+        }
+
+        // up to "limit" of the latest bars starting at or after "from", oldest first. the last one may still be filling.
+        std::vector<Candle> Since(Timestamp from, std::size_t limit) const{
+            std::vector<Candle> bars;
+            std::uint64_t first = count_ - std::min<std::uint64_t>({ count_, Capacity, limit });
+            for (std::uint64_t i = first; i < count_; i++){
+                const Candle& bar = bars_[i % Capacity];
+                if (bar.start_ >= from){
+                    bars.push_back(bar);
+                }
+            }
+            return bars;
+        }
+
+    private:
+        Candle& Current(){ return bars_[(count_ - 1) % Capacity]; }
+
+        Timestamp interval_;
+        std::vector<Candle> bars_;
+        std::uint64_t count_ { 0 }; // bars ever opened
+};
+
+// Hierarchical timing wheel (in the style of the Linux kernel timers) used to expire GFD/GTT orders.
+// Time is counted in 1ms ticks. Level 0 has one slot per tick, and every level above covers 256x more time per slot,
+// so 4 levels reach 2^32 ms (~49 days), anything further out waits in an overflow list.
+// Arm() and Disarm() are O(1): timers are nodes in a pooled, index-linked list, and a timer only moves
+// down a level ("cascades") when the wheel's time reaches the start of its slot.
+class TimerWheel{
+    public:
+        using TimerId = std::uint32_t;
+        static constexpr TimerId InvalidTimer = std::numeric_limits<TimerId>::max();
+
+        explicit TimerWheel(Timestamp now): current_(static_cast<std::uint64_t>(now)) {
+            heads_.fill(InvalidTimer);
+        }
+
+        std::size_t Size() const { return size_; }
+
+        TimerId Arm(Timestamp deadline, OrderId orderId){
+            TimerId id;
+            if (!free_.empty()){
+                id = free_.back();
+                free_.pop_back();
+            }else{
+                id = static_cast<TimerId>(nodes_.size());
+                nodes_.emplace_back();
+            }
+
+            Node& node = nodes_[id];
+            node.deadline_ = std::max<std::uint64_t>(static_cast<std::uint64_t>(deadline), current_ + 1);
+            node.orderId_ = orderId;
+            Link(id);
+            size_++;
+            return id;
+        }
+
+        void Disarm(TimerId id){
+            Unlink(id);
+            free_.push_back(id);
+            size_--;
+        }
+
+        // drops every armed timer and node at once (the book is being emptied). the vectors keep their capacity, so timers
+        // armed afterwards reuse that memory rather than allocating again.
+        void Clear(){
+            nodes_.clear();
+            free_.clear();
+            heads_.fill(InvalidTimer);
+            levelCounts_.fill(0);
+            size_ = 0;
+        }
+
+        // Moves the wheel forward to "now" and hands every expired order id to onExpired, in deadline order.
+        // Stretches with nothing armed in the lower levels are skipped a whole slot-span at a time.
+        template <typename OnExpired>
+        void Advance(Timestamp now, OnExpired&& onExpired){
+            const std::uint64_t target = static_cast<std::uint64_t>(std::max<Timestamp>(now, 0));
+            while (current_ < target){
+                if (size_ == 0){
+                    current_ = target;
+                    break;
+                }
+
+                int emptyLevels = 0;
+                while (emptyLevels < Levels && levelCounts_[emptyLevels] == 0){
+                    emptyLevels++;
+                }
+                if (emptyLevels > 0){
+                    // nothing can fire before the next boundary of the first non-empty level, jump straight to just before it.
+                    std::uint64_t span = (1ull << (LevelBits * emptyLevels)) - 1;
+                    current_ = std::min(target - 1, current_ | span);
+                }
+
+                current_++;
+                Cascade();
+
+                const std::size_t slot = current_ & SlotMask;
+                while (heads_[slot] != InvalidTimer){
+                    TimerId id = heads_[slot];
+                    OrderId orderId = nodes_[id].orderId_;
+                    Disarm(id);
+                    onExpired(orderId);
+                }
+            }
+        }
+
+    private:
+        static constexpr int LevelBits = 8;
+        static constexpr std::size_t SlotsPerLevel = 1u << LevelBits;
+        static constexpr std::uint64_t SlotMask = SlotsPerLevel - 1;
+        static constexpr int Levels = 4;
+        static constexpr std::size_t OverflowSlot = Levels * SlotsPerLevel;
+
+        struct Node{
+            std::uint64_t deadline_ { 0 };
+            OrderId orderId_ { 0 };
+            TimerId prev_ { InvalidTimer };
+            TimerId next_ { InvalidTimer };
+            std::uint32_t slot_ { 0 };
+        };
+
+        // the level is picked by the highest 8-bit group in which the deadline differs from the current time.
+        std::uint32_t SlotFor(std::uint64_t deadline) const{
+            for (int level = 0; level < Levels; level++){
+                if ((deadline >> (LevelBits * (level + 1))) == (current_ >> (LevelBits * (level + 1)))){
+                    return static_cast<std::uint32_t>(level * SlotsPerLevel + ((deadline >> (LevelBits * level)) & SlotMask));
+                }
+            }
+            return OverflowSlot;
+        }
+
+        void Link(TimerId id){
+            Node& node = nodes_[id];
+            node.slot_ = SlotFor(node.deadline_);
+            node.prev_ = InvalidTimer;
+            node.next_ = heads_[node.slot_];
+            if (node.next_ != InvalidTimer){
+                nodes_[node.next_].prev_ = id;
+            }
+            heads_[node.slot_] = id;
+            if (node.slot_ != OverflowSlot){
+                levelCounts_[node.slot_ / SlotsPerLevel]++;
+            }
+        }
+
+        void Unlink(TimerId id){
+            Node& node = nodes_[id];
+            if (node.prev_ != InvalidTimer){
+                nodes_[node.prev_].next_ = node.next_;
+            }else{
+                heads_[node.slot_] = node.next_;
+            }
+            if (node.next_ != InvalidTimer){
+                nodes_[node.next_].prev_ = node.prev_;
+            }
+            if (node.slot_ != OverflowSlot){
+                levelCounts_[node.slot_ / SlotsPerLevel]--;
+            }
+        }
+
+        // re-files every timer in "slot" relative to the new current time, which moves it down at least one level.
+        void Redistribute(std::size_t slot){
+            TimerId id = heads_[slot];
+            while (id != InvalidTimer){
+                TimerId next = nodes_[id].next_;
+                Unlink(id);
+                Link(id);
+                id = next;
+            }
+        }
+
+        // when current_ crosses the start of a higher-level slot, that slot's timers are pulled down.
+        // higher levels go first so their timers can land in a lower slot that is being cascaded in the same tick.
+        void Cascade(){
+            if ((current_ & ((1ull << (LevelBits * Levels)) - 1)) == 0){
+                Redistribute(OverflowSlot);
+            }
+            for (int level = Levels - 1; level >= 1; level--){
+                if ((current_ & ((1ull << (LevelBits * level)) - 1)) == 0){
+                    Redistribute(level * SlotsPerLevel + ((current_ >> (LevelBits * level)) & SlotMask));
+                }
+            }
+        }
+
+        std::uint64_t current_;
+        std::size_t size_ { 0 };
+        std::vector<Node> nodes_;
+        std::vector<TimerId> free_;
+        std::array<TimerId, OverflowSlot + 1> heads_;
+        std::array<std::size_t, Levels> levelCounts_ { };
+};
+
+// Running totals of displayed quantity and notional along one side of the book, as a Fenwick tree, so "how much is there
+// up to price P" and "where does a fill of Q end" are O(log n) instead of a walk over the levels.
+// Levels are addressed by rank, a price counted in the side's own best-first direction (minus the price for bids, the
+// price for asks), which makes every query a prefix sum. The tree covers a window of ranks starting a little better than
+// the touch. The book rebuilds it when a level appears before the window, and keeps levels past MaxSize ticks out of it
+// (it walks its map for those, they are rarely reached).
+class DepthLadder{
+    public:
+        static constexpr std::size_t MinSize = 1024;
+        static constexpr std::size_t MaxSize = 1 << 16;
+
+        struct Sums{
+            std::int64_t quantity_ { 0 };
+            std::int64_t notional_ { 0 };
+        };
+
+        bool Empty() const { return tree_.empty(); }
+        std::int64_t Low() const { return low_; }
+        std::int64_t End() const { return low_ + static_cast<std::int64_t>(tree_.size()); }
+        bool Contains(std::int64_t rank) const { return rank >= low_ && rank < End(); }
+
+        // covers [low, low + size) from now on, with everything zero. size has to be a power of two.
+        void Reset(std::int64_t low, std::size_t size){
+            low_ = low;
+            tree_.assign(size, Sums{ });
+        }
+
+        void Clear(){ tree_.clear(); }
+
+        // "quantity" more (or less, when negative) at "rank", which trades at "price".
+        void Add(std::int64_t rank, std::int64_t quantity, Price price){
+            std::int64_t notional = quantity * price;
+            for (std::size_t i = static_cast<std::size_t>(rank - low_) + 1; i <= tree_.size(); i += i & (~i + 1)){
+                tree_[i - 1].quantity_ += quantity;
+                tree_[i - 1].notional_ += notional;
+            }
+        }
+
+        // totals from the start of the window up to and including "rank".
+        Sums Prefix(std::int64_t rank) const{
+            Sums sums;
+            if (rank < low_){
+                return sums;
+            }
+            for (std::size_t i = std::min(static_cast<std::size_t>(rank - low_) + 1, tree_.size()); i > 0; i &= i - 1){
+                sums.quantity_ += tree_[i - 1].quantity_;
+                sums.notional_ += tree_[i - 1].notional_;
+            }
+            return sums;
+        }
+
+        Sums Total() const { return Prefix(End() - 1); }
+
+        // the first rank at which the running quantity reaches "quantity" (at most Total()), and the totals before it.
+        // the usual Fenwick descent: one pass from the largest power of two down, no prefix sums recomputed.
+        std::pair<std::int64_t, Sums> Search(std::int64_t quantity) const{
+            Sums before;
+            std::size_t position = 0;
+            for (std::size_t step = tree_.size(); step != 0; step >>= 1){
+                if (position + step > tree_.size()){
+                    continue;
+                }
+                const Sums& node = tree_[position + step - 1];
+                if (before.quantity_ + node.quantity_ < quantity){
+                    position += step;
+                    before.quantity_ += node.quantity_;
+                    before.notional_ += node.notional_;
+                }
+            }
+            return { low_ + static_cast<std::int64_t>(position), before };
+        }
+
+    private:
+        std::int64_t low_ { 0 };
+        std::vector<Sums> tree_;
+};
+
+// Orders and displayed quantity ahead of each order at one price level, as a Fenwick tree over arrival slots. an order
+// takes the next slot when it joins the back of the level, so what is in front of it is a prefix sum rather than a walk
+// down the FIFO. slots aren't reused: a full index doubles, unless most of its slots are dead, then it is better thrown
+// away and rebuilt from the level.
+class QueueIndex{
+    public:
+        struct Sums{
+            std::int64_t orders_ { 0 };
+            std::int64_t quantity_ { 0 };
+        };
+
+        // capacity has to be a power of two.
+        explicit QueueIndex(std::size_t capacity): tree_(capacity), slots_(capacity) {}
+
+        // an order of "quantity" joined the back of the level. false (and no slot) when it is full of mostly dead slots.
+        bool Append(Quantity quantity, std::uint32_t& slot){
+            if (next_ == slots_.size()){
+                if (live_ * 2 < slots_.size()){
+                    return false;
+                }
+                Grow();
+            }
+            slot = static_cast<std::uint32_t>(next_++);
+            live_++;
+            Add(slot, 1, quantity);
+            return true;
+        }
+
+        // the order in "slot" left the level.
+        void Remove(std::uint32_t slot){
+            Sums held = slots_[slot];
+            Add(slot, -held.orders_, -held.quantity_);
+            live_--;
+        }
+
+        void Add(std::uint32_t slot, std::int64_t orders, std::int64_t quantity){
+            slots_[slot].orders_ += orders;
+            slots_[slot].quantity_ += quantity;
+            for (std::size_t i = std::size_t{ slot } + 1; i <= tree_.size(); i += i & (~i + 1)){
+                tree_[i - 1].orders_ += orders;
+                tree_[i - 1].quantity_ += quantity;
+            }
+        }
+
+        // totals of every slot before "slot".
+        Sums Before(std::uint32_t slot) const{
+            Sums sums;
+            for (std::size_t i = slot; i > 0; i &= i - 1){
+                sums.orders_ += tree_[i - 1].orders_;
+                sums.quantity_ += tree_[i - 1].quantity_;
+            }
+            return sums;
+        }
+
+    private:
+        // twice the slots, with the tree rebuilt bottom up from the per-slot values in O(n).
+        void Grow(){
+            slots_.resize(slots_.size() * 2);
+            tree_ = slots_;
+            for (std::size_t i = 1; i <= tree_.size(); i++){
+                std::size_t parent = i + (i & (~i + 1));
+                if (parent <= tree_.size()){
+                    tree_[parent - 1].orders_ += tree_[i - 1].orders_;
+                    tree_[parent - 1].quantity_ += tree_[i - 1].quantity_;
+                }
+            }
+        }
+
+        std::vector<Sums> tree_;
+        std::vector<Sums> slots_; // what each slot holds on its own, so Remove() knows what to take out
+        std::size_t next_ { 0 };
+        std::size_t live_ { 0 };
+};
+
+// Inside a book, orders live in a slab and refer to each other by 32-bit index instead of shared_ptr + std::list node.
+using OrderIndex = std::uint32_t;
+constexpr OrderIndex NoOrder = std::numeric_limits<OrderIndex>::max();
+
+// The part of a resting order the match loop reads on every fill. 32 bytes, so two orders share a cache line,
+// and following next_ through a level brings the next order's quantity, price and owner in with it.
+struct alignas(32) OrderHot{
+    OrderId orderId_;
+    Price price_;
+    Quantity remaining_;    // displayed quantity still open
+    Quantity hidden_;       // iceberg reserve behind it
+    OrderIndex next_;       // next order in the same level, NoOrder at the back
+    AccountId owner_;
+    OrderType type_;
+    Side side_;
+    SelfTradePrevention selfTradePrevention_;
+
+    bool IsFilled() const { return remaining_ == 0 && hidden_ == 0; }
+    bool NeedsReplenish() const { return remaining_ == 0 && hidden_ != 0; }
+
+    // a triggered stop becomes a plain market order, a triggered stop-limit becomes a resting limit order.
+    void Trigger(){
+        type_ = type_ == OrderType::Stop ? OrderType::Market : OrderType::GoodTillCancel;
+    }
+};
+static_assert(sizeof(OrderHot) == 32, "two orders per cache line");
+
+// Everything else about an order, at the same index. only read when it is added, cancelled, expires or replenishes.
+struct OrderCold{
+    Timestamp expiry_ { 0 };
+    OrderIndex prev_ { NoOrder };
+    Quantity initial_ { 0 };
+    Quantity display_ { 0 };
+    Price stopPrice_ { 0 };
+    TimerWheel::TimerId expiryTimer_ { TimerWheel::InvalidTimer };
+    std::uint32_t queueSlot_ { 0 }; // its slot in the level's QueueIndex, while the level has one
+};
+
+// A price level's FIFO, as an intrusive list threaded through OrderHot::next_ and OrderCold::prev_.
+struct LevelQueue{
+    OrderIndex head_ { NoOrder };
+    OrderIndex tail_ { NoOrder };
+
+    bool Empty() const { return head_ == NoOrder; }
+};
+
+// the price levels of one side, best first.
+template <Side S>
+using Levels = std::map<Price, LevelQueue, typename SideTraits<S>::Compare>;
+
+// Slab of orders for one book, hot and cold halves in parallel arrays. Freed slots go on a free list and are only
+// handed out again by a later Allocate(), so an order's final state can still be read right after it is freed.
+// Indices stay valid as the slab grows, references don't: never hold an OrderHot& across an Allocate().
+class OrderPool{
+    public:
+        OrderIndex Allocate(const Order& order){
+            OrderIndex index;
+            if (!free_.empty()){
+                index = free_.back();
+                free_.pop_back();
+            }else{
+                index = static_cast<OrderIndex>(hot_.size());
+                hot_.emplace_back();
+                cold_.emplace_back();
+            }
+
+            hot_[index] = OrderHot{ order.GetOrderId(), order.GetPrice(), order.GetRemainingQuantity(), order.GetHiddenQuantity(), NoOrder,
+                order.GetOwner(), order.GetOrderType(), order.GetSide(), order.GetSelfTradePrevention() };
+            cold_[index] = OrderCold{ order.GetExpiry(), NoOrder, order.GetInitialQuantity(), order.GetDisplayQuantity(), order.GetStopPrice() };
+            return index;
+        }
+
+        void Free(OrderIndex index){ free_.push_back(index); }
+
+        // frees every slot at once.
+        void Clear(){
+            hot_.clear();
+            cold_.clear();
+            free_.clear();
+        }
+
+        OrderHot& Hot(OrderIndex index){ return hot_[index]; }
+        const OrderHot& Hot(OrderIndex index) const { return hot_[index]; }
+        OrderCold& Cold(OrderIndex index){ return cold_[index]; }
+        const OrderCold& Cold(OrderIndex index) const { return cold_[index]; }
+
+        void PushBack(LevelQueue& level, OrderIndex index){
+            hot_[index].next_ = NoOrder;
+            cold_[index].prev_ = level.tail_;
+            if (level.tail_ != NoOrder){
+                hot_[level.tail_].next_ = index;
+            }else{
+                level.head_ = index;
+            }
+            level.tail_ = index;
+        }
+
+        // O(1) from anywhere in the level, which is what cancels need.
+        void Unlink(LevelQueue& level, OrderIndex index){
+            OrderIndex prev = cold_[index].prev_;
+            OrderIndex next = hot_[index].next_;
+            if (prev != NoOrder){
+                hot_[prev].next_ = next;
+            }else{
+                level.head_ = next;
+            }
+            if (next != NoOrder){
+                cold_[next].prev_ = prev;
+            }else{
+                level.tail_ = prev;
+            }
+        }
+
+        void MoveToBack(LevelQueue& level, OrderIndex index){
+            Unlink(level, index);
+            PushBack(level, index);
+        }
+
+    private:
+        std::vector<OrderHot> hot_;
+        std::vector<OrderCold> cold_;
+        std::vector<OrderIndex> free_;
+};
+
+// How each of the most recent finished orders ended, so their status can still be asked for once they have left the
+// book. direct-mapped by the low bits of the id: recording is one store and a lookup one load, and an order is only
+// forgotten once a later id lands on its slot (with sequential ids, Capacity orders later).
+class FinishedOrders{
+    public:
+        static constexpr std::size_t Capacity = 1 << 14;
+
+        struct Entry{
+            OrderId orderId_ { 0 };
+            Price price_ { 0 };
+            Quantity initial_ { 0 };
+            Quantity filled_ { 0 };
+            Side side_ { Side::Buy };
+            bool recorded_ { false };
+            bool rejected_ { false }; // refused on arrival, see Orderbook::RejectOrder()
+        };
+
+        void Record(const Entry& entry){
+            if (entries_.empty()){
+                entries_.resize(Capacity); // allocated on first use, a book that never finishes an order doesn't pay for it.
+            }
+            entries_[entry.orderId_ & (Capacity - 1)] = entry;
+        }
+
+        const Entry* Find(OrderId orderId) const{
+            if (entries_.empty()){
+                return nullptr;
+            }
+            const Entry& entry = entries_[orderId & (Capacity - 1)];
+            return entry.recorded_ && entry.orderId_ == orderId ? &entry : nullptr;
+        }
+
+    private:
+        std::vector<Entry> entries_;
+};
+
+
+class Orderbook{
+    // An OrderBook holds orders, and we want to be easily able to access these orders (preferrable, in O(1) time). Any any point in time, the bids and asks we are about are:
+    // The bid with the HIGHEST price, and the ask with the LOWEST price.
+
+    private:
+        // every order the book knows about (resting, parked stop, or the one being added right now) has a slot here.
+        OrderPool pool_;
+
+        // map of key Price, and mapped value 'LevelQueue'. each side is sorted best price first (see SideTraits): bids descending, asks ascending.
+        Levels<Side::Buy> bids_;
+        Levels<Side::Sell> asks_;
+        // we don't need to sort our actual orders. these are just for the record (order id -> slot in pool_).
+        std::unordered_map<OrderId, OrderIndex> orders_;
+
+        // Stop / StopLimit orders that haven't triggered yet, indexed by stop price.
+        // buy stops fire once the last trade is >= their stop price, so the nearest one is the LOWEST price (std::less),
+        // sell stops fire once it is <= their stop price, so the nearest one is the HIGHEST (std::greater).
+        // after a trade only the front of each map has to be looked at.
+        std::map<Price, LevelQueue, std::less<Price>> buyStops_;
+        std::map<Price, LevelQueue, std::greater<Price>> sellStops_;
+        std::unordered_map<OrderId, OrderIndex> stops_;
+        std::optional<Price> lastTradePrice_;
+        Quantity lastTradeQuantity_ { 0 };
+
+        bool IsTriggered(OrderIndex index) const{
+            if (!lastTradePrice_){
+                return false;
+            }
+            Price stopPrice = pool_.Cold(index).stopPrice_;
+            return pool_.Hot(index).side_ == Side::Buy ? *lastTradePrice_ >= stopPrice : *lastTradePrice_ <= stopPrice;
+        }
+
+        void AddStopOrder(OrderIndex index){
+            const OrderHot& order = pool_.Hot(index);
+            Price stopPrice = pool_.Cold(index).stopPrice_;
+            LevelQueue& level = order.side_ == Side::Buy ? buyStops_[stopPrice] : sellStops_[stopPrice];
+            pool_.PushBack(level, index);
+            stops_.insert({order.orderId_, index});
+        }
+
+        void CancelStopOrder(OrderId orderId);
+
+        // moves every stop that the current last trade price has reached into "pending", nearest stop price first and
+        // FIFO within a price, buy stops before sell stops, so the injection order is fully deterministic.
+        template <typename Stops>
+        void CollectTriggered(Stops& stops, std::deque<OrderIndex>& pending){
+            while (!stops.empty() && IsTriggered(stops.begin()->second.head_)){
+                for (OrderIndex index = stops.begin()->second.head_; index != NoOrder; index = pool_.Hot(index).next_){
+                    stops_.erase(pool_.Hot(index).orderId_);
+                    pending.push_back(index);
+                }
+                stops.erase(stops.begin());
+            }
+        }
+
+        // Feeds triggered stops back into matching. Their fills can move the last trade price and trigger further stops,
+        // so this is a work queue rather than recursion: a long cascade grows the deque, never the call stack.
+        void ProcessTriggeredStops(Trades& trades);
+
+        // call auction state. the indicative uncross is only recomputed when someone asks for it after the levels changed
+        // (levelVersion_ is bumped by every level update), so a burst of arrivals during the call costs nothing extra.
+        TradingPhase phase_ { TradingPhase::Continuous };
+        std::uint64_t levelVersion_ { 0 };
+        mutable AuctionIndicative indicative_;
+        mutable std::uint64_t indicativeVersion_ { std::numeric_limits<std::uint64_t>::max() };
+
+        // Finds the price that maximises executable volume, in O(levels).
+        // One merge pass over both sides (in ascending price) builds the depth array, then cumulative ask depth
+        // ("supply at or below p") is summed forwards and cumulative bid depth ("demand at or above p") backwards.
+        // ties on volume go to the smallest imbalance, then to the price closest to the last trade.
+        AuctionIndicative ComputeEquilibrium() const;
+
+        // GFD/GTT expiry. the clock is injectable (see EngineClock), and GoodForDay orders expire at sessionClose_,
+        // given as milliseconds after midnight UTC.
+        EngineClock clock_;
+        Timestamp sessionClose_ { 16 * 60 * 60 * 1000 };
+        TimerWheel expiryWheel_;
+
+        Timestamp NextSessionClose(Timestamp now) const{
+            constexpr Timestamp DayMillis = 24 * 60 * 60 * 1000;
+            Timestamp close = (now / DayMillis) * DayMillis + sessionClose_;
+            return close > now ? close : close + DayMillis;
+        }
+
+        // every way a resting order leaves orders_ goes through here, so its expiry timer (if any) is released with it.
+        // the caller must already have unlinked it from its level. the slot itself is left alone (a repriced order keeps it).
+        void DetachOrder(OrderIndex index){
+            OrderCold& cold = pool_.Cold(index);
+            if (cold.expiryTimer_ != TimerWheel::InvalidTimer){
+                expiryWheel_.Disarm(cold.expiryTimer_);
+                cold.expiryTimer_ = TimerWheel::InvalidTimer;
+            }
+            orders_.erase(pool_.Hot(index).orderId_);
+        }
+
+        void EraseOrder(OrderIndex index){
+            DetachOrder(index);
+            FreeOrder(index);
+        }
+
+        // the last orders to leave the book, for GetOrderStatus().
+        FinishedOrders finished_;
+
+        void RecordFinished(OrderIndex index, bool rejected = false){
+            const OrderHot& order = pool_.Hot(index);
+            Quantity initial = pool_.Cold(index).initial_;
+            finished_.Record({ order.orderId_, order.price_, initial, initial - order.remaining_ - order.hidden_, order.side_, true, rejected });
+        }
+
+        // every slot goes back to the pool through here or RejectOrder() (or the whole pool is cleared, see CancelOrders()),
+        // so every order that ends is recorded in finished_ with what it had filled.
+        void FreeOrder(OrderIndex index){
+            RecordFinished(index);
+            pool_.Free(index);
+        }
+
+        // for an order refused before it could trade or rest, so its status reads "rejected" rather than "cancelled".
+        void RejectOrder(OrderIndex index){
+            RecordFinished(index, true);
+            pool_.Free(index);
+        }
+
+        // running totals for each price level, so questions about liquidity never have to walk the orders in a level.
+        // kept per side, because both sides can briefly hold the same price while an incoming order is being matched.
+        // quantity_ is the displayed quantity only, hiddenQuantity_ is the iceberg reserve behind it (still executable).
+        // queue_ is only built once someone asks for a queue position at the level, and goes with the level.
+        struct LevelData{
+            Quantity quantity_ { };
+            Quantity hiddenQuantity_ { };
+            Quantity count_ { };
+            std::unique_ptr<QueueIndex> queue_;
+
+            enum class Action{
+                Add,
+                Remove,
+                Match,
+                Replenish,
+                Reduce,
+            };
+        };
+        std::unordered_map<Price, LevelData> bidData_;
+        std::unordered_map<Price, LevelData> askData_;
+
+        // executable quantity (displayed + hidden) each account has resting at each level, kept per side by the same
+        // updates as bidData_/askData_. lets a fill-or-kill see how much of a level is its own with one lookup.
+        // anonymous orders (owner 0) are never self-trade checked, so they aren't tracked.
+        static constexpr std::uint64_t OwnerKey(Price price, AccountId owner){
+            return std::uint64_t{ static_cast<std::uint32_t>(price) } << 32 | owner;
+        }
+        std::unordered_map<std::uint64_t, Quantity> bidOwnerQuantity_;
+        std::unordered_map<std::uint64_t, Quantity> askOwnerQuantity_;
+
+        template <Side S>
+        Quantity OwnerQuantityAt(Price price, AccountId owner) const{
+            const auto& owners = S == Side::Buy ? bidOwnerQuantity_ : askOwnerQuantity_;
+            auto entry = owners.find(OwnerKey(price, owner));
+            return entry == owners.end() ? 0 : entry->second;
+        }
+
+        void UpdateOwnerQuantity(Side side, Price price, AccountId owner, std::int64_t quantity){
+            if (owner == 0 || quantity == 0){
+                return;
+            }
+            auto& owners = side == Side::Buy ? bidOwnerQuantity_ : askOwnerQuantity_;
+            Quantity& total = owners[OwnerKey(price, owner)];
+            ORDERBOOK_ASSERT(quantity > 0 || total >= static_cast<Quantity>(-quantity));
+            total = static_cast<Quantity>(total + quantity);
+            if (total == 0){
+                owners.erase(OwnerKey(price, owner));
+            }
+        }
+
+        // compile-time side selection, so per-side code never has to branch on which map it is looking at.
+        template <Side S>
+        Levels<S>& LevelsFor(){
+            if constexpr (S == Side::Buy){ return bids_; } else { return asks_; }
+        }
+        template <Side S>
+        const Levels<S>& LevelsFor() const{
+            if constexpr (S == Side::Buy){ return bids_; } else { return asks_; }
+        }
+        template <Side S>
+        const std::unordered_map<Price, LevelData>& LevelDataFor() const{
+            if constexpr (S == Side::Buy){ return bidData_; } else { return askData_; }
+        }
+        template <Side S>
+        std::unordered_map<Price, LevelData>& LevelDataFor(){
+            if constexpr (S == Side::Buy){ return bidData_; } else { return askData_; }
+        }
+
+        // "index" is the order the update is about, its side and price pick the level.
+        void UpdateLevelData(OrderIndex index, Quantity quantity, LevelData::Action action, Quantity hiddenQuantity = 0);
+
+        // keeps a level's queue index (when it has one) in step with the same update.
+        void UpdateQueueIndex(LevelData& data, OrderIndex index, Quantity quantity, LevelData::Action action);
+
+        // what is in front of a resting order on side S at its level, building the level's queue index if it has none.
+        template <Side S>
+        QueueIndex::Sums QueueAhead(OrderIndex index);
+
+        // per-side running totals of the displayed levels, kept in step by UpdateLevelData(), for EstimateFill() and
+        // QuantityAvailable().
+        DepthLadder bidDepth_;
+        DepthLadder askDepth_;
+
+        template <Side S>
+        static constexpr std::int64_t Rank(Price price){ return S == Side::Buy ? -std::int64_t{ price } : price; }
+        template <Side S>
+        static constexpr Price PriceAt(std::int64_t rank){ return static_cast<Price>(S == Side::Buy ? -rank : rank); }
+
+        template <Side S>
+        DepthLadder& DepthFor(){
+            if constexpr (S == Side::Buy){ return bidDepth_; } else { return askDepth_; }
+        }
+        template <Side S>
+        const DepthLadder& DepthFor() const{
+            if constexpr (S == Side::Buy){ return bidDepth_; } else { return askDepth_; }
+        }
+
+        // "quantity" more (or less) is displayed at "price". called once the level data already reflects it.
+        template <Side S>
+        void UpdateDepth(Price price, std::int64_t quantity);
+
+        // rebuilds the side's tree from its level data, with the window placed around the current touch.
+        template <Side S>
+        void RebuildDepth();
+
+        // the queries, for resting side S (the side an order of the opposite side would take from).
+        template <Side S>
+        FillEstimate EstimateFill(Quantity quantity) const;
+        template <Side S>
+        std::uint64_t QuantityAvailable(Price limit) const;
+
+        // Pre-trade risk state. accounts_ is indexed directly by AccountId, so a check is a handful of loads,
+        // and it lives in the book so it is always in step with the orders it describes.
+        RiskLimits riskLimits_;
+        std::vector<AccountRisk> accounts_;
+
+        AccountRisk& AccountFor(AccountId owner){
+            if (owner >= accounts_.size()){
+                accounts_.resize(owner + 1);
+            }
+            return accounts_[owner];
+        }
+
+        static std::uint64_t Notional(Price price, std::uint64_t quantity){
+            return static_cast<std::uint64_t>(std::abs(static_cast<std::int64_t>(price))) * quantity;
+        }
+
+        // CheckRisk() against the given account counters rather than the owner's current ones.
+        RiskReject CheckRisk(const Order& order, const AccountRisk& account) const;
+
+        // an account's counters as they would be with "order" off the book, to check the order that is about to replace it.
+        static AccountRisk WithoutOrder(AccountRisk account, const OrderHot& order){
+            std::uint64_t open = std::uint64_t{ order.remaining_ } + order.hidden_;
+            account.openOrders_--;
+            (order.side_ == Side::Buy ? account.openBuyQuantity_ : account.openSellQuantity_) -= open;
+            account.openNotional_ -= Notional(order.price_, open);
+            return account;
+        }
+
+        // open quantity/notional changes by "quantity" (positive when resting, negative when leaving the book).
+        void UpdateOpenRisk(const OrderHot& order, std::int64_t quantity){
+            AccountRisk& account = AccountFor(order.owner_);
+            std::uint64_t& open = order.side_ == Side::Buy ? account.openBuyQuantity_ : account.openSellQuantity_;
+            open += quantity;
+            account.openNotional_ += quantity * std::abs(static_cast<std::int64_t>(order.price_));
+        }
+
+        void RecordFill(AccountId buyer, AccountId seller, Quantity quantity){
+            AccountFor(buyer).position_ += quantity;
+            AccountFor(seller).position_ -= quantity;
+        }
+
+        void OnOrderAdded(OrderIndex index){
+            const OrderHot& order = pool_.Hot(index);
+            UpdateLevelData(index, order.remaining_, LevelData::Action::Add, order.hidden_);
+            AccountFor(order.owner_).openOrders_++;
+            UpdateOpenRisk(order, std::int64_t{ order.remaining_ } + order.hidden_);
+        }
+
+        void OnOrderCancelled(OrderIndex index){
+            const OrderHot& order = pool_.Hot(index);
+            UpdateLevelData(index, order.remaining_, LevelData::Action::Remove, order.hidden_);
+            AccountFor(order.owner_).openOrders_--;
+            UpdateOpenRisk(order, -(std::int64_t{ order.remaining_ } + order.hidden_));
+        }
+
+        // called after the order has been filled by "quantity". a fully filled order also leaves the level's count.
+        void OnOrderMatched(OrderIndex index, Quantity quantity);
+
+        // an iceberg at the front of "level" whose displayed slice just traded away shows its next slice and goes to the
+        // back of the FIFO. only the two list links are rewritten, so it is O(1) and the slot (and its index in orders_) stays put.
+        void ReplenishIceberg(LevelQueue& level){
+            OrderIndex index = level.head_;
+            OrderHot& order = pool_.Hot(index);
+            Quantity slice = std::min(pool_.Cold(index).display_, order.hidden_);
+            order.hidden_ -= slice;
+            order.remaining_ += slice;
+            UpdateLevelData(index, slice, LevelData::Action::Replenish);
+            pool_.MoveToBack(level, index);
+        }
+
+        // Can an order on side S with limit "price" from "owner" be filled for all of "quantity" right now?
+        // Walks the opposite levels from the best price using only the per-level totals (and the owner's own quantity at
+        // each level), so it costs O(levels crossed) and never mutates anything. what the owner's own orders count for
+        // depends on the self-trade prevention mode the sweep will use:
+        //  - CancelNewest/CancelBoth cancel the order when it reaches one of them, so a level it needs holding any is a kill.
+        //    the level totals don't say where in the FIFO they sit, so this is conservative.
+        //  - CancelOldest cancels them and carries on, so they are just not there.
+        //  - Decrement shrinks the order by them, which uses up its quantity as surely as a fill does.
+        template <Side S>
+        bool CanFullyFill(Price price, Quantity quantity, AccountId owner, SelfTradePrevention selfTradePrevention) const{
+            constexpr Side Opposite = SideTraits<S>::Opposite;
+            const auto& data = LevelDataFor<Opposite>();
+            std::uint64_t available = 0; // wider than Quantity, a deep book can hold more than uint32 max in total.
+            for (const auto& [levelPrice, queue] : LevelsFor<Opposite>()){
+                if (!SideTraits<S>::Crosses(price, levelPrice)){
+                    break;
+                }
+                // hidden iceberg reserve can't be seen, but it can still be traded against.
+                const LevelData& level = data.at(levelPrice);
+                std::uint64_t executable = std::uint64_t{ level.quantity_ } + level.hiddenQuantity_;
+                Quantity own = owner != 0 ? OwnerQuantityAt<Opposite>(levelPrice, owner) : 0;
+                if (own != 0){
+                    if (selfTradePrevention == SelfTradePrevention::CancelNewest || selfTradePrevention == SelfTradePrevention::CancelBoth){
+                        return false;
+                    }
+                    if (selfTradePrevention == SelfTradePrevention::CancelOldest){
+                        executable -= own;
+                    }
+                }
+                available += executable;
+                if (available >= quantity){
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // We need CanMatch() for fillandkill orders, because if it's can't match now, we never do it (now or never).
+        // otherwise, if we have a goodtillcancel order, we can add it to the orderbook, and then match it when possible.
+        // Upon match, we need to REMOVE the order from the orderbook. This may be completely remaining orders, or partially filled orders.
+        // only the best opposite level matters, it is the first one in that side's map.
+        template <Side S>
+        bool CanMatch(Price price) const{
+            const auto& opposite = LevelsFor<SideTraits<S>::Opposite>();
+            return !opposite.empty() && SideTraits<S>::Crosses(price, opposite.begin()->first);
+        }
+
+        // Removes the order at the front of "level" as a cancel, without erasing the level itself.
+        // used from inside the match loops, which hold references to the level and erase it themselves once it is empty.
+        void CancelFront(LevelQueue& level){
+            OrderIndex index = level.head_;
+            pool_.Unlink(level, index);
+            OnOrderCancelled(index);
+            EraseOrder(index);
+        }
+
+        // Shrinks a resting order's open quantity by "quantity" where it stands, so it keeps its place in the FIFO.
+        // the hidden reserve goes first: the displayed slice only gets smaller once there is nothing left behind it.
+        void ReduceOrder(OrderIndex index, Quantity quantity){
+            OrderHot& order = pool_.Hot(index);
+            Quantity hidden = std::min(order.hidden_, quantity);
+            Quantity displayed = quantity - hidden;
+            order.hidden_ -= hidden;
+            order.remaining_ -= displayed;
+            pool_.Cold(index).initial_ -= quantity; // not a fill, so FilledQuantity() mustn't move.
+            UpdateLevelData(index, displayed, LevelData::Action::Reduce, hidden);
+            UpdateOpenRisk(order, -std::int64_t{ quantity });
+        }
+
+        // mass cancel of one side's levels. whole levels in the band are dropped in one go, only an owner filter has to
+        // look at (and unlink) individual orders. returns how many orders were cancelled.
+        template <Side S>
+        std::size_t CancelLevels(const MassCancelFilter& filter);
+
+        template <typename Stops>
+        std::size_t CancelStops(Stops& stops, const MassCancelFilter& filter);
+
+        // puts an order (already in pool_) at the back of its price level and indexes it, without matching it.
+        template <Side S>
+        void RestOrder(OrderIndex index);
+
+        // takes a resting order off its level and out of orders_ exactly like a cancel, but leaves its slot allocated
+        // so it can be given a new price and rested again.
+        void LiftOrder(OrderIndex index);
+
+        // gives a lifted order a new side, price and quantity.
+        void ResetOrder(OrderIndex index, Side side, Price price, Quantity quantity);
+
+        // each account's current quote legs, by order id. a leg that has traded away or been cancelled just isn't in orders_ any more.
+        struct QuoteOrders{
+            OrderId bid_ { 0 };
+            OrderId ask_ { 0 };
+        };
+        std::unordered_map<AccountId, QuoteOrders> quotes_;
+
+        // brings one quote leg to "side" without matching: reduced in place, requeued at a new price or size, pulled,
+        // or created. returns the leg's slot, or NoOrder if that side isn't quoted any more.
+        template <Side S>
+        OrderIndex PlaceQuoteSide(const Quote& quote, const QuoteSide& side, OrderId& live);
+
+        // after a fill (or an STP decrement), drop the front order if it is done, or show its next iceberg slice.
+        void SettleFront(LevelQueue& level);
+
+        // Self-trade prevention, applied when the two orders about to trade share an owner. The newest order's mode decides.
+        // newestLevel is null when the newest order is an aggressor that never rests (a Market/FOK sweep).
+        // Returns true if the newest order was cancelled, so it must stop matching.
+        bool PreventSelfTrade(OrderIndex newest, LevelQueue* newestLevel, LevelQueue& oldestLevel);
+
+        // Matches the crossed top of the book after "incoming" has been inserted.
+        // only the incoming order can be crossing, so it is always the newest order in any self-trade.
+        // An auction uncross passes NoOrder and the uncross price instead: every trade prints at that price,
+        // and only bids at or above it / asks at or below it take part.
+        Trades MatchOrders(OrderIndex incoming, std::optional<Price> auctionPrice = std::nullopt);
+
+        // Aggressor-side walk: the incoming order (on side S) is matched straight against the opposite side, best level
+        // first, and is never inserted into bids_/asks_/orders_. Used for orders that can never rest (Market, FOK), so
+        // there is nothing to insert, match, and then cancel again afterwards.
+        template <Side S>
+        Trades SweepOrder(OrderIndex aggressor, Price limit);
+
+        // need to add, cancel, and modify order(s).
+
+        // Given a new Order (the pointer to it), this method adds it to our orderbook.
+        // it checks if the order already exists, if the order is a fillandkill and can NOT be immediately matched (both cases where we do NOT add).
+        public:
+            Orderbook(EngineClock clock = SystemClockNow):
+                clock_(std::move(clock)),
+                expiryWheel_(clock_()) {}
+
+            // Cancels every GFD/GTT order whose expiry has passed, in one batch.
+            // Runs at the start of every mutation (so an expired order can never trade) and from the engine's expiry sweeper.
+            void ExpireOrders();
+
+            // GFD/GTT orders waiting on the expiry wheel. with none, ExpireOrders() has nothing it could cancel.
+            std::size_t ArmedExpiries() const { return expiryWheel_.Size(); }
+
+            // the order is copied into the book, and its quantities (and GFD expiry) are written back before this returns.
+            Result<Trades> AddOrder(OrderPointer order);
+
+            std::optional<Price> GetLastTradePrice() const { return lastTradePrice_; }
+
+            // State, fills and queue position of an order, whether it is resting, a parked stop, or one of the last
+            // finished ones (see FinishedOrders). a lookup, plus O(log n) for the position. not const: the first position
+            // asked for at a level builds that level's queue index, and expired orders are swept first.
+            Result<OrderStatus> GetOrderStatus(OrderId orderId);
+
+            // What an order of "side" for "quantity" would fill right now if it swept the book with no limit: how much, at
+            // what total notional and down to which level. O(log levels), only displayed quantity counts.
+            FillEstimate EstimateFill(Side side, Quantity quantity) const;
+
+            // How much an order of "side" could take with "limit" as its limit price (displayed quantity only).
+            std::uint64_t QuantityAvailable(Side side, Price limit) const;
+
+            // Lock-free: unlike everything else here this can be called from any thread while another one is changing
+            // the book, and always returns the top of book as it was between two of those changes.
+            TopOfBook GetTopOfBook() const { return topOfBook_.Load(); }
+
+            // Lock-free too: up to "limit" executions from sequence "from" on, oldest first, out of the last
+            // TradeTape::Capacity. FindTrade() is the sequence of the first one at or after "time", GetTradeCount() the
+            // sequence the next one will get.
+            std::vector<TapeTrade> GetTrades(std::uint64_t from, std::size_t limit) const { return tape_.Since(from, limit); }
+            std::uint64_t FindTrade(Timestamp time) const { return tape_.Find(time); }
+            std::uint64_t GetTradeCount() const { return tape_.Next(); }
+
+            // OHLCV bars are kept for 1s, 1m and 5m unless told otherwise. setting the intervals starts every series afresh.
+            // intervals are in milliseconds and have to be positive.
+            void SetCandleIntervals(const std::vector<Timestamp>& intervals){
+                candles_.clear();
+                for (Timestamp interval : intervals){
+                    candles_.emplace_back(interval);
+                }
+            }
+
+            // up to "limit" of the latest bars of "interval" starting at or after "from", oldest first, or nothing if the book
+            // doesn't keep that interval.
+            std::optional<std::vector<Candle>> GetCandles(Timestamp interval, Timestamp from, std::size_t limit) const{
+                for (const CandleSeries& series : candles_){
+                    if (series.Interval() == interval){
+                        return series.Since(from, limit);
+                    }
+                }
+                return std::nullopt;
+            }
+
+            TradingPhase GetPhase() const { return phase_; }
+
+            void SetRiskLimits(const RiskLimits& limits){ riskLimits_ = limits; }
+            const RiskLimits& GetRiskLimits() const { return riskLimits_; }
+
+            AccountRisk GetAccountRisk(AccountId owner) const{
+                return owner < accounts_.size() ? accounts_[owner] : AccountRisk{ };
+            }
+
+            // Pre-trade check, run before AddOrder. Everything it needs is already counted in accounts_,
+            // so there is no scan over the account's orders. Market orders are priced at the last trade for the notional checks.
+            RiskReject CheckRisk(const Order& order) const;
+
+            // The same check for the order a modify would put back through matching, counted without the order it replaces.
+            // a cut in place (same side and price, less quantity) always passes. run it before MatchOrder().
+            RiskReject CheckRisk(const OrderModify& modify) const;
+
+            // Both legs of a quote, counted without the account's live legs they replace. either one failing refuses the
+            // whole quote. run it before UpdateQuote().
+            RiskReject CheckRisk(const Quote& quote) const;
+
+            // starts a call: from now on orders rest without matching until UncrossAuction().
+            void OpenAuction(){
+                phase_ = TradingPhase::Auction;
+            }
+
+            // the uncross the auction would produce right now (empty outside of an auction).
+            AuctionIndicative GetAuctionIndicative() const;
+
+            // Ends the call: executes everything that crosses at the equilibrium price and returns to continuous trading.
+            Result<Trades> UncrossAuction();
+
+        private:
+            // every public call that changes the book publishes the new top of book on its way out, whichever way it returns.
+            // calls made from inside another one (ExpireOrders(), CancelOrder() from matching) leave it to the outermost,
+            // so readers never see a command half applied.
+            struct PublishOnReturn{
+                Orderbook& book_;
+                bool outermost_ { !std::exchange(book_.inCommand_, true) };
+
+                ~PublishOnReturn(){
+                    if (outermost_){
+                        book_.inCommand_ = false;
+                        book_.PublishTopOfBook();
+                    }
+                }
+            };
+
+            // every execution also goes on the tape, stamped with the time the command started (see ExpireOrders()).
+            TradeTape tape_;
+            Timestamp now_ { 0 };
+
+            // and into every candle interval the book keeps.
+            std::vector<CandleSeries> candles_{ CandleSeries{ 1000 }, CandleSeries{ 60 * 1000 }, CandleSeries{ 5 * 60 * 1000 } };
+
+            void RecordTrade(OrderId buyOrderId, OrderId sellOrderId, Price price, Quantity quantity, Side aggressor, bool auction = false){
+                tape_.Append(TapeTrade{ 0, now_, buyOrderId, sellOrderId, price, quantity, aggressor, auction });
+                for (CandleSeries& series : candles_){
+                    series.Add(now_, price, quantity);
+                }
+            }
+
+            // levelVersion_ moves with every level update (a trade always updates one), so an unchanged version means
+            // there is nothing new to publish and the bids_/asks_ lookups are skipped.
+            void PublishTopOfBook();
+            SeqLock<TopOfBook> topOfBook_;
+            TopOfBook published_;
+            std::uint64_t publishedVersion_ { 0 };
+            bool inCommand_ { false };
+
+            // runs one (non-stop) order through matching. only called with no untriggered stop left to process.
+            // this is where a command picks its side, everything below it is compiled separately for bids and asks.
+            // an order that doesn't end up resting has its slot freed before this returns.
+            Result<Trades> ExecuteOrder(OrderIndex index);
+
+            template <Side S>
+            Result<Trades> ExecuteOrder(OrderIndex index);
+
+            // takes a cancelled order off its price level, dropping the level once it is empty.
+            template <Side S>
+            void RemoveFromLevel(Price price, OrderIndex index);
+
+        public:
+            // method to REMOVE an order from the orderbook if it is cancelled.
+            Result<void> CancelOrder(OrderId orderId);
+
+            
+            // Modifies a resting order. Cutting its quantity on the same side and price is done in place and keeps its queue
+            // priority. anything else (a new price or side, or more quantity) takes it off its level and runs it through
+            // matching again as if it had just arrived, with the same id, type, expiry, display size and owner.
+            // the order's slot is reused either way, nothing is allocated.
+            Result<Trades> MatchOrder(OrderModify order);
+
+            // Kill switch: cancels every order matching "filter" and returns how many went. With no filter at all the book is
+            // simply emptied (no per-order work beyond the account counters), otherwise matching levels are dropped whole.
+            std::size_t CancelOrders(const MassCancelFilter& filter = { });
+
+            // Everything UpdateQuote() would refuse, without changing the book. lets a mass quote check every book before touching any.
+            Result<void> CheckQuote(const Quote& quote) const;
+
+            // Replaces the account's bid and ask in one step. a leg that only shrinks keeps its queue priority, and both legs
+            // go through a single matching pass afterwards (a valid quote can only cross the book on one side).
+            Result<QuoteAck> UpdateQuote(const Quote& quote);
+
+            // untriggered stops count as live orders too (they can be cancelled), they just aren't on a price level yet.
+            std::size_t Size() const { return orders_.size() + stops_.size();}
+
+            OrderBookLevelInfo GetOrderInfos() const;
+
+            // A hash of everything that decides what the book does next: every resting order in queue order, the parked
+            // stops, every account's counters, the phase, the last trade price and how many trades there have been.
+            // two books fed the same commands at the same times have the same checksum, so a replica can check it is still
+            // in step with its primary. O(orders).
+            std::uint64_t Checksum() const;
+
+};
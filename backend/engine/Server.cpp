@@ -1,433 +1,35 @@
 #include "httplib.h"
+#include "Orderbook.h"
+#include "JournalRecord.h"
+#include "LatencyHistogram.h"
+#include "BookRegistry.h"
 #include <iostream>
 #include <string>
-#include <map>
+#include <string_view>
 #include <unordered_map>
-#include <set>
-#include <list>
-#include <cmath>
-#include <ctime>
-#include <cstdint>
 #include <vector>
 #include <format>
-#include <stdexcept>
 #include <memory>
-#include <iterator>
-#include <numeric>
+#include <limits>
 #include <atomic>
 #include <mutex>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <thread>
+#include <condition_variable>
+#include <sstream>
+#include <stdexcept>
+#include <deque>
+#include <optional>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
 
 using namespace std;
 
-// "Order"s will have two Time Enforcement options.
-enum class OrderType{
-    GoodTillCancel,
-    FillAndKill
-};
-
-// "Order"s will have a Side. Side::Buy or Side::Sell
-enum class Side{
-    Buy,
-    Sell
-};
-
-// alias types
-using Price = std::int32_t; // price can be negative
-using Quantity = std::uint32_t;
-using OrderId = std::uint64_t;
-
-// in cpp we denote "member varaibles" (i.e not parameters) with a "_".
-
-struct LevelInfo{
-    Price price_;
-    Quantity quantity_;
-};
-
-// LevelInfos stores all the Quantity's at a certain price (level).
-using LevelInfos = std::vector<LevelInfo>;
-
-// OrderBookLevelInfo stores the vectors for asks and bids for all prices.
-class OrderBookLevelInfo{
-    // we need seperate vectors for bids and asks
-    public:
-        OrderBookLevelInfo(const LevelInfos& asks, const LevelInfos& bids):
-        // constructor instantiation
-        asks_(asks),
-        bids_(bids) {}
-
-        const LevelInfos& GetBids() const { return bids_; }
-        const LevelInfos& GetAsks() const { return asks_; }
-    
-    private:
-        LevelInfos bids_;
-        LevelInfos asks_;
-};
-
-// What is added to the order book? Objets that have the order type, key, side, price, quantity, and bool(s) for filled or not
-// Order stores instances of an order (with all needed properties).
-class Order {
-    // A PUBLIC constructor can initialize private fields.
-    public:
-        Order(OrderType orderType, Side side, Price price, Quantity quantity, OrderId orderId): 
-            orderType_(orderType),
-            orderId_(orderId),
-            price_(price),
-            side_(side),
-            initialQuantity_(quantity),
-            remainingQuantity_(quantity) {}
-
-        // const in the function sig. means it will NOT alter the members (getts and setters, bools).
-        OrderId GetOrderId() const { return orderId_; }
-        Side GetSide() const { return side_; }
-        Price GetPrice() const { return price_; }
-        OrderType GetOrderType() const { return orderType_; }
-        Quantity GetInitialQuantity() const { return initialQuantity_; }
-        Quantity GetRemainingQuantity() const { return remainingQuantity_; }
-        Quantity FilledQuantity() const { return GetInitialQuantity() - GetRemainingQuantity();}
-        bool IsFilled() const { return GetRemainingQuantity() == 0;}
-
-        void Fill(Quantity quantity){
-            // validate if the # of orders can actually be filled
-            if (quantity > GetRemainingQuantity()){
-                throw std::logic_error(std::format("Order ({}) cannot be filled for more than it's remaining quantity", GetOrderId()));
-            }
-
-            remainingQuantity_ -= quantity; // it has been filled
-        }
-
-
-        // the reason we need this private section here is because without it, we declare the variables in our public: modifier, but never assign them a type.
-    private:
-        OrderType orderType_;
-        OrderId orderId_;
-        Price price_;
-        Side side_;
-        Quantity initialQuantity_;
-        Quantity remainingQuantity_;
-};
-
-// Orders go into multiple data structures, so we will keep a pointer to orders. (reference semantics) so we can easily reference them.
-// std::make_shared<type>(); allocates order(s) on the heap, and returns a pointer pointing at it.
-
-// So here, we have a vector of POINTERS to orders.
-using OrderPointer = std::shared_ptr<Order>;
-using OrderPointers = std::list<OrderPointer>; // we use a LIST because if we have orders at the same price, we want a FIFO order.
-
-// Common functionality we need to support for orders:
-
-// Add() => we need a new order.
-// Cancel() => we need an existing valid order id.
-// Modify() => we need a way to modify existing orders, and we need to retrieve orders in a well manner.
-
-class OrderModify{
-    public:
-        OrderModify(OrderId orderId, Side side, Price price, Quantity quantity):
-        orderId_(orderId),
-        side_(side),
-        price_(price),
-        quantity_(quantity) {}
-
-    OrderId GetOrderId() const {return orderId_;}
-    Price GetPrice() const {return price_;}
-    Side GetSide() const {return side_;}
-    Quantity GetQuantity() const {return quantity_;}
-
-    // "const" in this function denotes the function does NOT modify any member variables.
-    OrderPointer ToOrderPointer(OrderType type) const {
-    return std::make_shared<Order>(type, GetSide(), GetPrice(), GetQuantity(), GetOrderId());
-}
-
-    private:
-        OrderId orderId_;
-        Side side_;
-        Price price_;
-        Quantity quantity_;
-};
-
-// TradeInfo may exist by itself, but Trade can contain or reference one or more TradeInfo objects.
-struct TradeInfo{
-    OrderId orderid_;
-    Price price_;
-    Quantity quantity_;
-};
-
-// A trade consists of a bid and ask, which will hava TradeInfo objects for eahch.
-class Trade{
-    public:
-
-        Trade(const TradeInfo& bidTrade, const TradeInfo& askTrade):
-        bidTrade_ { bidTrade},
-        askTrade_ { askTrade} {}
-
-        const TradeInfo& GetBidTrade(){return bidTrade_;}
-        const TradeInfo& GetAskTrade(){return askTrade_;}
-
-    private:
-        TradeInfo bidTrade_;
-        TradeInfo askTrade_;
-};
-
-
-// vector of trade object, representing bids and asks
-using Trades = std::vector<Trade>;
-
-class Orderbook{
-    // An OrderBook holds orders, and we want to be easily able to access these orders (preferrable, in O(1) time). Any any point in time, the bids and asks we are about are:
-    // The bid with the HIGHEST price, and the ask with the LOWEST price.
-
-    private:
-        // when an entry is to be ordered, we take the pointer to the specified entries.
-        struct OrderEntry{
-            OrderPointer order_ { nullptr };
-            OrderPointers::iterator location_;
-        };
-
-        // hashmap of key Price, and mapped value 'OrderPointers'. std::greater<Price> is a custom comparator to sort upon, where it's in descending order. (highest ASK first!).
-        std::map<Price, OrderPointers, std::greater<Price>> bids_;
-        std::map<Price, OrderPointers, std::less<Price>> asks_;
-        // we don't need to sort our actual orders. these are just for the record.
-        std::unordered_map<OrderId, OrderEntry> orders_;
-
-        // We need CanMatch() for fillandkill orders, because if it's can't match now, we never do it (now or never).
-        // otherwise, if we have a goodtillcancel order, we can add it to the orderbook, and then match it when possible.
-        // Upon match, we need to REMOVE the order from the orderbook. This may be completely remaining orders, or partially filled orders.
-
-        bool CanMatch(Side side, Price price) const{
-              if (side == Side::Buy){
-                
-                if (asks_.empty()){
-                    return false;
-                }else{
-                    const auto& [bestAsk, _] = *asks_.begin(); // starts at the best ask (lowest price!).
-                    return price >= bestAsk; // we return the best match possible, and return if it is valid or not.
-                }
-              }
-
-            //   copying for other side
-              if (side == Side::Sell){
-                if (bids_.empty()){
-                    return false;
-                }else{
-                    const auto& [bestBid, _] = *bids_.begin();
-                    return price <= bestBid; 
-                }
-              }
-          }
-
-        // We also need a Match() function that runs when a match actually occurs. 
-        // Replace your MatchOrders() function with this debug version:
-
-Trades MatchOrders(){
-    std::cout << "\n[DEBUG] MatchOrders called" << std::flush;
-    Trades trades;
-    trades.reserve(orders_.size());
-
-    std::cout << "\n[DEBUG] Bids empty: " << bids_.empty() << ", Asks empty: " << asks_.empty() << std::flush;
-
-    while (true){
-        if (bids_.empty() || asks_.empty()){ 
-            std::cout << "\n[DEBUG] One side empty, breaking" << std::flush;
-            break;
-        }
-        
-        std::cout << "\n[DEBUG] Getting best bid and ask" << std::flush;
-        auto& [askPrice, asks] = *asks_.begin();
-        auto& [bidPrice, bids] = *bids_.begin();
-        
-        std::cout << "\n[DEBUG] BidPrice: " << bidPrice << ", AskPrice: " << askPrice << std::flush;
-    
-        if (bidPrice < askPrice){ 
-            std::cout << "\n[DEBUG] No match possible, breaking" << std::flush;
-            break; 
-        }
-
-        std::cout << "\n[DEBUG] Starting match loop" << std::flush;
-        while (!bids.empty() && !asks.empty()){
-            std::cout << "\n[DEBUG] Getting front orders" << std::flush;
-            auto& bid = bids.front();
-            auto& ask = asks.front();
-
-            std::cout << "\n[DEBUG] Bid ID: " << bid->GetOrderId() << ", Ask ID: " << ask->GetOrderId() << std::flush;
-
-            Quantity quantity = std::min(bid->GetRemainingQuantity(), ask->GetRemainingQuantity());
-            std::cout << "\n[DEBUG] Matching quantity: " << quantity << std::flush;
-            
-            bid->Fill(quantity);
-            ask->Fill(quantity);
-            
-            std::cout << "\n[DEBUG] Creating trade log" << std::flush;
-            trades.push_back(Trade{
-                TradeInfo{ bid->GetOrderId(), bid->GetPrice(), quantity},
-                TradeInfo{ ask->GetOrderId(), ask->GetPrice(), quantity}
-            });
-            
-            std::cout << "\n[DEBUG] Checking if orders filled" << std::flush;
-            if (bid->IsFilled()){
-                std::cout << "\n[DEBUG] Removing filled bid" << std::flush;
-                OrderId bidId = bid->GetOrderId();
-                bids.pop_front();
-                orders_.erase(bidId);
-            }
-            if (ask->IsFilled()){
-                std::cout << "\n[DEBUG] Removing filled ask" << std::flush;
-                OrderId askId = ask->GetOrderId();
-                asks.pop_front();
-                orders_.erase(askId);
-            }
-        }
-        
-        std::cout << "\n[DEBUG] Inner loop done, checking empty" << std::flush;
-        if (bids.empty()){ 
-            std::cout << "\n[DEBUG] Erasing bid price level" << std::flush;
-            bids_.erase(bidPrice);
-        }
-        if (asks.empty()){ 
-            std::cout << "\n[DEBUG] Erasing ask price level" << std::flush;
-            asks_.erase(askPrice);
-        }
-    }
-
-    std::cout << "\n[DEBUG] Main matching done, checking FillAndKill" << std::flush;
-
-    // Handle FillAndKill orders that didn't fully fill
-    if (!bids_.empty()){
-        std::cout << "\n[DEBUG] Checking bids for FillAndKill" << std::flush;
-        auto bidIter = bids_.begin();
-        auto& [_, bidsRef] = *bidIter;
-        if (!bidsRef.empty()) {
-            auto& order = bidsRef.front();
-            if (order->GetOrderType() == OrderType::FillAndKill && !order->IsFilled()){
-                std::cout << "\n[DEBUG] Canceling unfilled FillAndKill bid" << std::flush;
-                OrderId orderId = order->GetOrderId();
-                CancelOrder(orderId);
-            }
-        }
-    }
-
-    if (!asks_.empty()){
-        std::cout << "\n[DEBUG] Checking asks for FillAndKill" << std::flush;
-        auto askIter = asks_.begin();
-        auto& [_, asksRef] = *askIter;
-        if (!asksRef.empty()) {
-            auto& order = asksRef.front();
-            if (order->GetOrderType() == OrderType::FillAndKill && !order->IsFilled()){
-                std::cout << "\n[DEBUG] Canceling unfilled FillAndKill ask" << std::flush;
-                OrderId orderId = order->GetOrderId();
-                CancelOrder(orderId);
-            }
-        }
-    }
-    
-    std::cout << "\n[DEBUG] MatchOrders returning" << std::flush;
-    return trades;
-}
-
-        // need to add, cancel, and modify order(s).
-
-        // Given a new Order (the pointer to it), this method adds it to our orderbook.
-        // it checks if the order already exists, if the order is a fillandkill and can NOT be immediately matched (both cases where we do NOT add).
-        public:
-            Trades AddOrder(OrderPointer order){
-                if (orders_.contains(order->GetOrderId())){ return { };}
-
-                if (order->GetOrderType() == OrderType::FillAndKill && !CanMatch(order->GetSide(), order->GetPrice())){
-                    return { };
-                }
-                
-                // iteator to OrderPointers, which is simply a LIST. allows access for O(1) remove/cancellation.
-                // bids_ is our buy-side storage, whereas asks_ is our sell-side storage.
-                OrderPointers::iterator iterator;
-
-                if (order->GetSide() == Side::Buy){
-                    auto& orders = bids_[order->GetPrice()]; 
-                    // this line causes INSERTION, where the price of the order is used as the key, and simultaneously gives an "orders" alias which is the list of orders at the specific price level.
-                    // so we insert an order (with Price as the key) and retrieve the reference to the list (value).
-                    orders.push_back(order);
-                    iterator = std::next(orders.begin(), orders.size()-1);
-                    // the order is added to the back of the list (FIFO), and the iterator wil calculate the exact position of the order we just inserted. (for O(1) removal later if needed).
-                }else{
-                    auto& orders = asks_[order->GetPrice()];
-                    orders.push_back(order);
-                    iterator = std::next(orders.begin(), orders.size()-1);
-                }
-
-                // general bookkeeping in the orders_ OrderBook.
-                orders_.insert({order->GetOrderId(), OrderEntry{ order, iterator}});
-                return MatchOrders();
-            }
-            
-            // method to REMOVE an order from the orderbook if it is cancelled.
-            void CancelOrder(OrderId orderId){
-            if (!orders_.contains(orderId)){
-                return;
-            }
-            // we need aliases to the order and iterator (retrieved from orders_ using the orderId). Then we can remove it from the orders_.
-            const auto& [order, orderIterator] = orders_.at(orderId);
-            orders_.erase(orderId);
-
-            // if it's a sell order, we remove it from the asks_ data structure. if it's empty after, we need to remove the price altogether from it (memory cleanup).
-
-            if (order->GetSide() == Side::Sell){
-                auto price = order->GetPrice();
-                auto& orders = asks_.at(price);
-                orders.erase(orderIterator);
-                if (orders.empty()){
-                    asks_.erase(price);
-                }
-            }else{
-                auto price = order->GetPrice();
-                auto& orders = bids_.at(price);
-                orders.erase(orderIterator);
-                if (orders.empty()){
-                    bids_.erase(price);
-                }
-            }}
-
-            
-            Trades MatchOrder(OrderModify order){
-                if (!orders_.contains(order.GetOrderId())){
-                    return { };
-                }
-
-                // fetch information of an order, cancel the order, and add the modified version back.
-                const auto& [existingOrder, _] = orders_.at(order.GetOrderId());
-                CancelOrder(order.GetOrderId());
-                return AddOrder(order.ToOrderPointer(existingOrder->GetOrderType()));
-            }
-
-            std::size_t Size() const { return orders_.size();}
-
-            OrderBookLevelInfo GetOrderInfos() const{
-                // alias for a LevelInfo vector, and we allocate memory in each LevelInfos (orders_ is conservative, we can use asks_ and bids_ if we really wanted to).
-                LevelInfos askinfos, bidinfos;
-                bidinfos.reserve(orders_.size());
-                askinfos.reserve(orders_.size());
-
-                // this is a lambda function that takes a Price and list of OrderPointers at that price, and returns a LevelInfo struct containing all of them (struct has Price and TotalQuantity).
-                // accumulate iterates from orders.start to orders.end, starts with a value of 0, and adds the sum of OrderPointer() in an order.'
-
-                // so within OrderPointers -> OrderPointer -> OrderPointer Quantity is what we want the sum of. Tells us how many shares are "up for consideration".
-                auto CreateLevelInfos = [](Price price, const OrderPointers& orders){
-                    return LevelInfo{ price, std::accumulate(orders.begin(), orders.end(), (Quantity)0, [](std::size_t runningSum, const OrderPointer& order){
-                        return runningSum + order->GetRemainingQuantity();
-                    })};
-                };
-
-                // finally, for each pricelevel in bids_, we take the pricelevel & OrderPointers (which point to all the live orders)
-                // we calcualte the total sum/quantity of shares in all orders at the price level COMBINED.
-                // push that number back to bidinfos and askinfos.
-                for (const auto& [price, orders] : bids_)
-                    bidinfos.push_back(CreateLevelInfos(price, orders));
-                
-                for (const auto& [price, orders] : asks_)
-                    askinfos.push_back(CreateLevelInfos(price, orders));
-                // in the end, bidinfos and askinfos is a vector of the "LevelInfo" object, which stores price-totalquantity pair(s). 
-                // helps us find the liquidity of shares at certain prices, using asks/bids.
-                return OrderBookLevelInfo(askinfos, bidinfos);
-            }
-
-};
-
 OrderType setType(string type){
     if (type == "goodtillcancel"){
         return OrderType::GoodTillCancel;
@@ -455,11 +57,21 @@ struct Counter{
     }
 };
 
-std::mutex gLock;
-std::unordered_map<string, Orderbook> MyMap;
+// risk limits every book starts with, changed at runtime through POST /risk. gRiskLock is always taken before a book's lock.
+std::mutex gRiskLock;
+RiskLimits gRiskLimits;
+
+// candle intervals (ms) every book keeps, from ORDERBOOK_CANDLES. only written before the server starts.
+std::vector<Timestamp> gCandleIntervals{ 1000, 60 * 1000, 5 * 60 * 1000 };
 
 OrderType parse_ordertype(string type){
     if (type == "GTC"){return OrderType::GoodTillCancel;}
+    else if (type == "MKT" || type == "MARKET"){return OrderType::Market;}
+    else if (type == "FOK"){return OrderType::FillOrKill;}
+    else if (type == "GFD"){return OrderType::GoodForDay;}
+    else if (type == "GTT"){return OrderType::GoodTillTime;}
+    else if (type == "STOP"){return OrderType::Stop;}
+    else if (type == "STOPLIMIT"){return OrderType::StopLimit;}
     else{return OrderType::FillAndKill;}
 }
 
@@ -468,6 +80,14 @@ Side parse_side(string side){
     else{return Side::Sell;}
 }
 
+// STP modes: CN (cancel newest, the default), CO (cancel oldest), CB (cancel both), DC (decrement)
+SelfTradePrevention parse_stp(string stp){
+    if (stp == "CO"){return SelfTradePrevention::CancelOldest;}
+    else if (stp == "CB"){return SelfTradePrevention::CancelBoth;}
+    else if (stp == "DC"){return SelfTradePrevention::Decrement;}
+    else{return SelfTradePrevention::CancelNewest;}
+}
+
 // Use stoull (string to unsigned long long) for OrderId (uint64_t)
 OrderId parse_id(string id){
     // This supports values up to 18 quintillion (uint64_t max)
@@ -487,8 +107,285 @@ Price parse_price(string price){
     return std::stoi(price);
 }
 
+// candle intervals: a number with an ms, s, m or h suffix (a bare number is milliseconds), e.g. 500ms, 1s, 1m, 5m.
+Timestamp parse_interval(string interval){
+    std::size_t digits = 0;
+    Timestamp value = std::stoll(interval, &digits);
+    string unit = interval.substr(digits);
+    Timestamp scale = unit == "s" ? 1000 : unit == "m" ? 60 * 1000 : unit == "h" ? 60 * 60 * 1000 : 1;
+    if (value <= 0 || !(unit.empty() || unit == "ms" || scale != 1)){
+        throw std::invalid_argument("bad candle interval: " + interval);
+    }
+    return value * scale;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Latency instrumentation.
+// Every request records a handful of timestamps on its own thread, and the deltas are folded into
+// lock-free histograms once the response is written. /metrics exports them in Prometheus format.
+// TickClock and LatencyHistogram themselves are in LatencyHistogram.h.
+// ---------------------------------------------------------------------------------------------
+
+// one histogram per stage of a request, per endpoint.
+struct EndpointMetrics{
+    const char* name_;
+    LatencyHistogram parse_;    // request start -> parameters parsed
+    LatencyHistogram lockWait_; // parameters parsed -> book lock acquired
+    LatencyHistogram engine_;   // engine call start -> end (AddOrder, CancelOrder, MatchOrder, serializing the books)
+    LatencyHistogram total_;    // request start -> response written to the socket
+};
+
+EndpointMetrics gTradeMetrics{"trade"};
+EndpointMetrics gCancelMetrics{"cancel"};
+EndpointMetrics gModifyMetrics{"modify"};
+EndpointMetrics gQuoteMetrics{"quote"};
+EndpointMetrics gCancelAllMetrics{"cancelall"};
+EndpointMetrics gStatusMetrics{"status"};
+EndpointMetrics gBboMetrics{"bbo"};
+
+// Timestamps for the request currently running on this thread. httplib handles a request start-to-finish on one
+// worker thread, so a thread_local is enough to carry them from the pre-routing hook to the logger hook.
+struct RequestTrace{
+    EndpointMetrics* endpoint_ = nullptr;
+    std::uint64_t start_ = 0;
+    std::uint64_t parsed_ = 0;
+    std::uint64_t locked_ = 0;
+    std::uint64_t engineStart_ = 0;
+    std::uint64_t engineEnd_ = 0;
+
+    void Begin(){ *this = RequestTrace{}; start_ = TickClock::Now(); }
+    void MarkParsed(){ parsed_ = TickClock::Now(); }
+    void MarkLocked(){ locked_ = TickClock::Now(); }
+    void MarkEngineStart(){ engineStart_ = TickClock::Now(); }
+    void MarkEngineEnd(){ engineEnd_ = TickClock::Now(); }
+
+    // called once the response has been written. stages that never happened (e.g. a 400 before locking) are skipped.
+    void Finish(){
+        if (endpoint_ == nullptr || start_ == 0){
+            return;
+        }
+        std::uint64_t end = TickClock::Now();
+        auto record = [](LatencyHistogram& histogram, std::uint64_t from, std::uint64_t to){
+            if (from != 0 && to >= from){
+                histogram.Record(TickClock::ToNanos(to - from));
+            }
+        };
+        record(endpoint_->parse_, start_, parsed_);
+        record(endpoint_->lockWait_, parsed_, locked_);
+        record(endpoint_->engine_, engineStart_, engineEnd_);
+        record(endpoint_->total_, start_, end);
+        endpoint_ = nullptr;
+    }
+};
+
+thread_local RequestTrace tTrace;
+
+// ---------------------------------------------------------------------------------------------
+// Book registry.
+// Symbols are interned to a small BookId once, at startup (ORDERBOOK_SYMBOLS) or through POST /books. Books are never
+// removed, so the name -> id table is insert-only and request threads look names up without taking a lock. Each book
+// lives behind its own pointer, so its address never changes, and has its own mutex, so trading in one book no
+// longer waits on another. Unknown names are rejected instead of allocating a book. Book and BookRegistry are in
+// BookRegistry.h.
+// ---------------------------------------------------------------------------------------------
+
+BookRegistry gBooks;
+
+// interned at startup when ORDERBOOK_SYMBOLS (a comma separated list) isn't set.
+constexpr const char* DefaultSymbols = "AAPL,AMZN,GOOG,META,MSFT,NVDA,TSLA";
+
+// request-path lookup, never allocates. nullptr for a name that was never added.
+Book* find_book(const string& name){
+    BookId id = gBooks.Find(name);
+    return id == BookRegistry::InvalidBook ? nullptr : &gBooks.Get(id);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Order routing (see OrderRouter in BookRegistry.h).
+// ---------------------------------------------------------------------------------------------
+
+OrderRouter gRouter;
+
+// the book named by "name", or when it is empty the book order "id" was placed in. nullptr if neither finds one.
+Book* route_order(const string& name, OrderId id){
+    if (!name.empty()){
+        return find_book(name);
+    }
+    BookId book = gRouter.Find(id);
+    return book == BookRegistry::InvalidBook ? nullptr : &gBooks.Get(book);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Replication.
+// With ORDERBOOK_REPLICATION=async or sync the server keeps a journal: every command that changes a book is written down,
+// in the order the book applied it and with the time the book saw. A replica (ORDERBOOK_ROLE=replica) long-polls the
+// primary's GET /journal and runs the same commands at the same times on its own books, so it ends up in the same state
+// trade for trade and can take over through POST /promote. Every second the primary also journals a checksum of each book
+// that changed, which the replica compares with its own. In sync mode a request that changed a book isn't answered until
+// the replica has applied it, or SyncAckTimeout has passed (then it is answered anyway and counted).
+// ---------------------------------------------------------------------------------------------
+
+enum class ReplicationMode{
+    Off,
+    Async,
+    Sync,
+};
+
+// the journal lives in memory. records are "time book op args...", numbered from 0 in the order they were appended.
+// a record is dropped once the replica has acknowledged it, and with no replica keeping up only the last MaxRecords are
+// kept, so a replica can only catch up while the records it needs are still here.
+class Journal{
+    public:
+        static constexpr std::size_t MaxRecords = 1 << 20;
+
+        void Enable(){ enabled_.store(true, std::memory_order_relaxed); }
+        bool Enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+        // returns the record's sequence number. callers hold the lock of the book the record is about (gRiskLock for
+        // books being added and risk limits), so a book's records are in the order the book applied them.
+        std::uint64_t Append(string record){
+            std::lock_guard<std::mutex> lock(lock_);
+            records_.push_back(std::move(record));
+            if (records_.size() > MaxRecords){
+                records_.pop_front();
+                first_++;
+            }
+            appended_.notify_all();
+            return first_ + records_.size() - 1;
+        }
+
+        // up to "max" records from "from" on as "seq record" lines, waiting up to "wait" for there to be one. empty when
+        // "from" has already been dropped. asking for "from" acknowledges every record before it, and drops them.
+        std::optional<string> Read(std::uint64_t from, std::size_t max, std::chrono::milliseconds wait){
+            std::unique_lock<std::mutex> lock(lock_);
+            lastRead_ = std::chrono::steady_clock::now();
+            if (from < first_){
+                return std::nullopt;
+            }
+            if (from > acked_){
+                acked_ = std::min<std::uint64_t>(from, first_ + records_.size());
+                acknowledged_.notify_all();
+            }
+            while (first_ < acked_){
+                records_.pop_front();
+                first_++;
+            }
+            appended_.wait_for(lock, wait, [&]{ return first_ + records_.size() > from; });
+            string body;
+            for (std::uint64_t seq = std::max(from, first_); seq < first_ + records_.size() && seq - from < max; seq++){
+                body += std::format("{} {}\n", seq, records_[seq - first_]);
+            }
+            return body;
+        }
+
+        // whether record "seq" has been acknowledged within "timeout". doesn't wait at all when no replica has polled
+        // lately, so a primary whose replica is gone isn't held up on every request.
+        bool WaitForAck(std::uint64_t seq, std::chrono::milliseconds timeout){
+            std::unique_lock<std::mutex> lock(lock_);
+            if (std::chrono::steady_clock::now() - lastRead_ > std::chrono::seconds(2)){
+                return acked_ > seq;
+            }
+            return acknowledged_.wait_for(lock, timeout, [&]{ return acked_ > seq; });
+        }
+
+        std::uint64_t Next() const{
+            std::lock_guard<std::mutex> lock(lock_);
+            return first_ + records_.size();
+        }
+
+        // the oldest record still kept.
+        std::uint64_t First() const{
+            std::lock_guard<std::mutex> lock(lock_);
+            return first_;
+        }
+
+        std::uint64_t Acked() const{
+            std::lock_guard<std::mutex> lock(lock_);
+            return acked_;
+        }
+
+    private:
+        mutable std::mutex lock_;
+        std::condition_variable appended_;
+        std::condition_variable acknowledged_;
+        std::deque<string> records_;
+        std::uint64_t first_ = 0; // sequence number of records_.front()
+        std::uint64_t acked_ = 0;
+        std::chrono::steady_clock::time_point lastRead_;
+        std::atomic<bool> enabled_{ false };
+};
+
+// the mode and role are only written before the server starts (and the role by POST /promote, see gFollowing).
+ReplicationMode gReplicationMode = ReplicationMode::Off;
+Journal gJournal;
+constexpr std::chrono::milliseconds SyncAckTimeout{ 250 };
+std::atomic<std::uint64_t> gSyncTimeouts{ 0 };
+
+// the last record the request on this thread journaled, so sync mode knows what to wait for once it has been handled.
+constexpr std::uint64_t NotJournaled = std::numeric_limits<std::uint64_t>::max();
+thread_local std::uint64_t tJournaled = NotJournaled;
+
+// a replica follows its primary until it is promoted. it takes no orders while it does.
+std::atomic<bool> gFollowing{ false };
+// set when a record can't be applied: the replica's books no longer match the primary's, so it stops following (but
+// still takes no orders) rather than apply anything after the gap.
+std::atomic<bool> gDiverged{ false };
+std::atomic<std::uint64_t> gChecksPassed{ 0 };
+std::atomic<std::uint64_t> gChecksFailed{ 0 };
+
+// every command that changes a book goes through here with the book's lock held, right before the engine runs it: the
+// book's clock moves to now and, when journaling, the command is written down with that time. "describe" returns the
+// op and its arguments, and is only called when journaling.
+template <typename Describe>
+void begin_command(Book& entry, Describe&& describe){
+    entry.now_ = SystemClockNow();
+    if (gJournal.Enabled()){
+        entry.changed_ = true;
+        tJournaled = gJournal.Append(std::format("{} {} {}", entry.now_, entry.id_, describe()));
+    }
+}
+
+// symbols end up in JSON keys and Prometheus labels unescaped, so keep them to a safe alphabet.
+bool valid_symbol(const string& name){
+    if (name.empty() || name.size() > 32){
+        return false;
+    }
+    for (char c : name){
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '.' && c != '-' && c != '_'){
+            return false;
+        }
+    }
+    return true;
+}
+
+// interns a symbol with the current risk limits. returns InvalidBook for a bad name or a full registry.
+std::pair<BookId, bool> add_book(const string& name){
+    if (!valid_symbol(name)){
+        return { BookRegistry::InvalidBook, false };
+    }
+    std::lock_guard<std::mutex> lock(gRiskLock);
+    // books are only ever added here, under gRiskLock, so the id a new book gets is known before it is added. the record
+    // goes first, so no command on the book can be journaled ahead of it.
+    Timestamp now = SystemClockNow();
+    if (gJournal.Enabled() && gBooks.Find(name) == BookRegistry::InvalidBook && gBooks.Size() < BookRegistry::MaxBooks){
+        tJournaled = gJournal.Append(std::format("{} {} book {}", now, gBooks.Size(), name));
+    }
+    return gBooks.Add(name, gRiskLimits, gCandleIntervals, now);
+}
+
+// HTTP status for an engine refusal. most are conflicts with the book's state, the 400s are requests that could never have worked.
+int order_error_status(OrderError error){
+    switch (error){
+        case OrderError::UnknownOrder: return 404;
+        case OrderError::Expired:
+        case OrderError::QuoteWithoutAccount:
+        case OrderError::CrossedQuote: return 400;
+        default: return 409;
+    }
+}
 
 void server_trade(const httplib::Request& req, httplib::Response& res){
+    tTrace.endpoint_ = &gTradeMetrics;
     try{
         // parse content'
         string s_orderid = req.get_param_value("orderid");
@@ -497,27 +394,108 @@ void server_trade(const httplib::Request& req, httplib::Response& res){
         string s_price = req.get_param_value("price");
         string s_quantity = req.get_param_value("quantity");
         string s_book = req.get_param_value("book");
+        string s_expiry = req.get_param_value("expiry");
+        string s_stopprice = req.get_param_value("stopprice");
+        string s_displayqty = req.get_param_value("displayqty");
+        string s_account = req.get_param_value("account");
+        string s_stp = req.get_param_value("stp");
+
+        OrderType type = parse_ordertype(s_type);
+        // market (and stop-market) orders have no limit price, so price is optional for them.
+        bool priceRequired = type != OrderType::Market && type != OrderType::Stop;
+        bool isStop = type == OrderType::Stop || type == OrderType::StopLimit;
 
-        if (s_book.empty() || s_orderid.empty() || s_type.empty() || s_side.empty() || s_price.empty() || s_quantity.empty()) {
+        if (s_book.empty() || s_orderid.empty() || s_type.empty() || s_side.empty() || (priceRequired && s_price.empty()) || s_quantity.empty()
+            || (type == OrderType::GoodTillTime && s_expiry.empty()) || (isStop && s_stopprice.empty())) {
                     res.status = 400; // Bad Request
                     res.set_content(R"({"error":"Missing required parameters"})", "application/json");
                     return;
                 }
         OrderId id = parse_id(s_orderid);
-        OrderType type = parse_ordertype(s_type);
         Side side = parse_side(s_side);
-        Price price = parse_price(s_price);
+        Price price = s_price.empty() ? 0 : parse_price(s_price);
         Quantity quantity = parse_quantity(s_quantity);
+        Quantity displayQuantity = s_displayqty.empty() ? 0 : parse_quantity(s_displayqty);
+        unsigned long account = s_account.empty() ? 0 : std::stoul(s_account);
+        if (account > MaxAccountId){
+            res.status = 400;
+            res.set_content(std::format(R"({{"error":"account must be between 0 and {}"}})", MaxAccountId), "application/json");
+            return;
+        }
+
+        // a hidden reserve only makes sense for orders that can rest on a price level.
+        bool canRest = type == OrderType::GoodTillCancel || type == OrderType::GoodForDay || type == OrderType::GoodTillTime || type == OrderType::StopLimit;
+        if (displayQuantity != 0 && !canRest){
+            res.status = 400;
+            res.set_content(R"({"error":"displayqty is only supported for GTC, GFD, GTT and STOPLIMIT orders"})", "application/json");
+            return;
+        }
+        tTrace.MarkParsed();
+
+        Book* entry = find_book(s_book);
+        if (entry == nullptr){
+            res.status = 404;
+            res.set_content(R"({"message": "Book not found"})", "application/json");
+            return;
+        }
 
+        OrderPointer order;
+        Result<Trades> result;
         {
-        std::lock_guard<std::mutex> lock(gLock);;
-        Orderbook& book = MyMap[s_book];
-        book.AddOrder(std::make_shared<Order>(type, side, price, quantity, id));
-        
-        cout << "\n " << book.Size();
+        std::lock_guard<std::mutex> lock(entry->lock_);
+        tTrace.MarkLocked();
+        Orderbook& book = entry->book_;
+        BookMetrics& bookMetrics = entry->metrics_;
+
+        order = std::make_shared<Order>(type, side, price, quantity, id);
+        if (type == OrderType::GoodTillTime){
+            order->SetExpiry(std::stoll(s_expiry));
+        }
+        if (isStop){
+            order->SetStopPrice(parse_price(s_stopprice));
+        }
+        order->SetDisplayQuantity(displayQuantity);
+        order->SetOwner(static_cast<AccountId>(account), parse_stp(s_stp));
+
+        RiskReject reject = book.CheckRisk(*order);
+        if (reject != RiskReject::None){
+            res.status = 403;
+            res.set_content(std::format(R"({{"error":"Order rejected by risk check: {}"}})", RiskRejectName(reject)), "application/json");
+            return;
+        }
+
+        begin_command(*entry, [&]{
+            return std::format("trade {} {} {} {} {} {} {} {} {} {}", id, static_cast<int>(type), static_cast<int>(side), price, quantity,
+                order->GetExpiry(), order->GetStopPrice(), displayQuantity, account, static_cast<int>(order->GetSelfTradePrevention()));
+        });
+        tTrace.MarkEngineStart();
+        result = book.AddOrder(order);
+        tTrace.MarkEngineEnd();
+        // routed while the book is still locked, so a cancel or modify by id that follows can't miss the order.
+        if (result){
+            gRouter.Record(id, entry->id_);
+        }
+
+        bookMetrics.lockWait_.Record(TickClock::ToNanos(tTrace.locked_ - tTrace.parsed_));
+        bookMetrics.match_.Record(TickClock::ToNanos(tTrace.engineEnd_ - tTrace.engineStart_));
+        }
+        if (!result){
+            res.status = order_error_status(result.error());
+            res.set_content(std::format(R"({{"error":"Order rejected: {}"}})", OrderErrorName(result.error())), "application/json");
+            return;
         }
         res.status = 200; // or httplib::StatusCode::OK_200
-        res.set_content("{\"message\": \"Order placed successfully\"}", "application/json");
+        if (type == OrderType::Market){
+            // a market order never rests, so anything it couldn't fill has been cancelled.
+            res.set_content(std::format(R"({{"message": "Market order executed", "filled": {}, "cancelled": {}}})",
+                order->FilledQuantity(), order->GetRemainingQuantity()), "application/json");
+        }else if (type == OrderType::FillOrKill){
+            res.set_content(std::format(R"({{"message": "{}", "filled": {}, "cancelled": {}}})",
+                order->IsFilled() ? "FillOrKill order filled" : "FillOrKill order killed",
+                order->FilledQuantity(), order->GetRemainingQuantity()), "application/json");
+        }else{
+            res.set_content("{\"message\": \"Order placed successfully\"}", "application/json");
+        }
     }catch(const std::exception& e) {
         // Catch standard C++ errors (like bad numeric conversion)
         res.status = 500; // Internal Server Error is better for conversion errors
@@ -531,35 +509,44 @@ void server_trade(const httplib::Request& req, httplib::Response& res){
 
 }
 
-// Note: This assumes the global map std::unordered_map<string, Orderbook> MyMap;
+// Note: This assumes the global registry gBooks
 // and conversion functions like parse_id are globally defined.
 
 void server_cancel(const httplib::Request& req, httplib::Response& res) {
+    tTrace.endpoint_ = &gCancelMetrics;
     try{
         // parse content
         string s_orderid = req.get_param_value("orderid");
         string s_book = req.get_param_value("book");
 
-        if (s_orderid.empty() || s_book.empty()){
+        // book is optional, without it the order is routed by its id.
+        if (s_orderid.empty()){
             res.status = 400; // Bad Request
             res.set_content(R"({"error":"Missing required parameters"})", "application/json");
             return;
         }
 
         OrderId id = parse_id(s_orderid);
-        
-        std::lock_guard<std::mutex> lock(gLock);
-        Orderbook& book = MyMap[s_book];
-        size_t before = book.Size();
-        book.CancelOrder(id);
-        size_t after = book.Size();
-        
+        tTrace.MarkParsed();
 
-        if (after < before){
-            cout << "\n " << s_orderid << " " << s_book;
-        res.status = 200;
-        res.set_content("{\"message\": \"Order Info Received\"}", "application/json");
-        cout << "\n Cancelled OrderID: " << s_orderid << " in book: " << s_book << " new size:  " << book.Size();
+        Book* entry = route_order(s_book, id);
+        if (entry == nullptr){
+            res.status = 404;
+            res.set_content(s_book.empty() ? R"({"message": "Order ID not found"})" : R"({"message": "Book not found"})", "application/json");
+            return;
+        }
+        
+        std::lock_guard<std::mutex> lock(entry->lock_);
+        tTrace.MarkLocked();
+        Orderbook& book = entry->book_;
+        begin_command(*entry, [&]{ return std::format("cancel {}", id); });
+        tTrace.MarkEngineStart();
+        Result<void> result = book.CancelOrder(id);
+        tTrace.MarkEngineEnd();
+
+        if (result){
+            res.status = 200;
+            res.set_content("{\"message\": \"Order Info Received\"}", "application/json");
         }else {
             res.status = 404;
             res.set_content("{\"message\": \"Order ID not found\"}", "application/json");
@@ -567,65 +554,494 @@ void server_cancel(const httplib::Request& req, httplib::Response& res) {
     }catch(...){
         res.status = 500;
         res.set_content(R"({"error":"Unknown internal server error."})", "application/json");
-        cout << "\n There was an error";
+        std::cerr << "Error in server_cancel" << std::endl;
     }
 }
 
-std::string level_infos_to_json(const OrderBookLevelInfo& info, size_t size) {
-    auto convert_levels = [](const LevelInfos& levels, const std::string& type) {
-        std::string json_array = "[";
-        bool first = true;
-        for (const auto& level : levels) {
-            if (!first) {
-                json_array += ",";
-            }
-            json_array += std::format(
-                R"({{"type":"{}", "price":{}, "quantity":{}}})",
-                type, level.price_, level.quantity_
-            );
-            first = false;
+// POST /modify, changes a resting order's side, price and/or quantity. like /cancel, book can be left out.
+// a smaller quantity at the same side and price keeps the order's queue position, anything else re-queues it (and may trade).
+void server_modify(const httplib::Request& req, httplib::Response& res) {
+    tTrace.endpoint_ = &gModifyMetrics;
+    try{
+        string s_orderid = req.get_param_value("orderid");
+        string s_book = req.get_param_value("book");
+        string s_side = req.get_param_value("side");
+        string s_price = req.get_param_value("price");
+        string s_quantity = req.get_param_value("quantity");
+
+        if (s_orderid.empty() || s_side.empty() || s_price.empty() || s_quantity.empty()){
+            res.status = 400;
+            res.set_content(R"({"error":"Missing required parameters"})", "application/json");
+            return;
         }
-        json_array += "]";
-        return json_array;
-    };
 
-    return std::format(
-        R"({{"bids":{}, "asks":{}, "size":{}}})",
-        convert_levels(info.GetBids(), "Bid"),
-        convert_levels(info.GetAsks(), "Ask"),
-        size
-    );
-}
+        OrderModify modify{ parse_id(s_orderid), parse_side(s_side), parse_price(s_price), parse_quantity(s_quantity) };
+        tTrace.MarkParsed();
 
-// NOTE: This relies on the OrderBookLevelInfo, LevelInfos, Price, and Quantity types being correctly defined earlier in Server.cpp.
+        Book* entry = route_order(s_book, modify.GetOrderId());
+        if (entry == nullptr){
+            res.status = 404;
+            res.set_content(s_book.empty() ? R"({"message": "Order ID not found"})" : R"({"message": "Book not found"})", "application/json");
+            return;
+        }
 
-std::string all_orderbooks_to_json() {
-    std::string json_output = "{";
-    bool first = true;
-    
-    // MyMap is the global std::unordered_map<string, Orderbook>
-    for (const auto& pair : MyMap) { 
-        if (!first) {
-            json_output += ",";
+        std::lock_guard<std::mutex> lock(entry->lock_);
+        tTrace.MarkLocked();
+        // checked like a new order on /trade, before the old one comes off the book, so a refused modify leaves it resting.
+        RiskReject reject = entry->book_.CheckRisk(modify);
+        if (reject != RiskReject::None){
+            res.status = 403;
+            res.set_content(std::format(R"({{"error":"Order not modified, risk check: {}"}})", RiskRejectName(reject)), "application/json");
+            return;
         }
-        std::string book_name = pair.first;
-        const Orderbook& book = pair.second;
 
-        // Uses the existing utility to get the JSON for one book
-        std::string book_json_content = level_infos_to_json(book.GetOrderInfos(), book.Size());
-        
-        // Format the book name as the key, and insert the book's JSON content
-        // We remove the outer braces from book_json_content to embed it correctly
-        json_output += std::format(R"("{}":{})", book_name, book_json_content);
-        first = false;
+        begin_command(*entry, [&]{
+            return std::format("modify {} {} {} {}", modify.GetOrderId(), static_cast<int>(modify.GetSide()), modify.GetPrice(), modify.GetQuantity());
+        });
+        tTrace.MarkEngineStart();
+        Result<Trades> result = entry->book_.MatchOrder(modify);
+        tTrace.MarkEngineEnd();
+
+        if (!result){
+            res.status = order_error_status(result.error());
+            res.set_content(std::format(R"({{"error":"Order not modified: {}"}})", OrderErrorName(result.error())), "application/json");
+            return;
+        }
+        res.status = 200;
+        res.set_content(std::format(R"({{"message": "Order modified", "trades": {}}})", result->size()), "application/json");
+    }catch(const std::exception& e){
+        res.status = 500;
+        std::cerr << "Error in server_modify: " << e.what() << std::endl;
+        res.set_content(std::format(R"({{"error":"Engine error during processing: {}"}})", e.what()), "application/json");
     }
-    json_output += "}";
-    return json_output;
 }
 
-void server_status(const httplib::Request& req, httplib::Response& res) {
-    try {
-        std::string status_json = all_orderbooks_to_json();
+// POST /quote, replaces an account's two-sided quote in one or more books (a mass quote).
+// one quote=BOOK,bidid,bidprice,bidqty,askid,askprice,askqty field per book (httplib drops repeated key=value pairs,
+// so the fields can't simply be repeated per book), account and stp are shared by all of them.
+// every book in the message is locked (in registry order, so two mass quotes can't deadlock) and checked before any of
+// them is changed, so the whole message is applied or refused as one.
+void server_quote(const httplib::Request& req, httplib::Response& res) {
+    tTrace.endpoint_ = &gQuoteMetrics;
+    try{
+        string s_account = req.get_param_value("account");
+        std::size_t count = req.get_param_value_count("quote");
+
+        if (count == 0 || s_account.empty()){
+            res.status = 400;
+            res.set_content(R"({"error":"Missing required parameters"})", "application/json");
+            return;
+        }
+        unsigned long account = std::stoul(s_account);
+        if (account > MaxAccountId){
+            res.status = 400;
+            res.set_content(std::format(R"({{"error":"account must be between 0 and {}"}})", MaxAccountId), "application/json");
+            return;
+        }
+        SelfTradePrevention stp = parse_stp(req.get_param_value("stp"));
+
+        struct BookQuote{
+            BookId id_;
+            Book* book_;
+            Quote quote_;
+        };
+        std::vector<BookQuote> quotes;
+        quotes.reserve(count);
+        for (std::size_t i = 0; i < count; i++){
+            std::vector<string> fields;
+            string value = req.get_param_value("quote", i);
+            for (std::size_t start = 0, comma; start <= value.size(); start = comma + 1){
+                comma = std::min(value.find(',', start), value.size());
+                fields.push_back(value.substr(start, comma - start));
+            }
+            if (fields.size() != 7){
+                res.status = 400;
+                res.set_content(R"({"error":"quote must be BOOK,bidid,bidprice,bidqty,askid,askprice,askqty"})", "application/json");
+                return;
+            }
+
+            BookId id = gBooks.Find(fields[0]);
+            if (id == BookRegistry::InvalidBook){
+                res.status = 404;
+                res.set_content(R"({"message": "Book not found"})", "application/json");
+                return;
+            }
+            Quote quote{ static_cast<AccountId>(account), stp,
+                QuoteSide{ parse_id(fields[1]), parse_price(fields[2]), parse_quantity(fields[3]) },
+                QuoteSide{ parse_id(fields[4]), parse_price(fields[5]), parse_quantity(fields[6]) } };
+            quotes.push_back(BookQuote{ id, &gBooks.Get(id), quote });
+        }
+        tTrace.MarkParsed();
+
+        std::sort(quotes.begin(), quotes.end(), [](const BookQuote& a, const BookQuote& b){ return a.id_ < b.id_; });
+        auto repeated = std::adjacent_find(quotes.begin(), quotes.end(), [](const BookQuote& a, const BookQuote& b){ return a.id_ == b.id_; });
+        if (repeated != quotes.end()){
+            res.status = 400;
+            res.set_content(std::format(R"({{"error":"{} is quoted more than once"}})", repeated->book_->name_), "application/json");
+            return;
+        }
+
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(quotes.size());
+        for (BookQuote& quote : quotes){
+            locks.emplace_back(quote.book_->lock_);
+        }
+        tTrace.MarkLocked();
+        tTrace.MarkEngineStart();
+
+        for (BookQuote& quote : quotes){
+            Result<void> valid = quote.book_->book_.CheckQuote(quote.quote_);
+            if (!valid){
+                res.status = order_error_status(valid.error());
+                res.set_content(std::format(R"({{"error":"Quote rejected for {}: {}"}})", quote.book_->name_, OrderErrorName(valid.error())), "application/json");
+                return;
+            }
+            RiskReject reject = quote.book_->book_.CheckRisk(quote.quote_);
+            if (reject != RiskReject::None){
+                res.status = 403;
+                res.set_content(std::format(R"({{"error":"Quote rejected for {} by risk check: {}"}})", quote.book_->name_, RiskRejectName(reject)), "application/json");
+                return;
+            }
+        }
+
+        string body = R"({"message": "Quotes updated", "quotes": [)";
+        for (BookQuote& quote : quotes){
+            // CheckQuote() and CheckRisk() have just passed with the lock held, so UpdateQuote() shouldn't refuse.
+            begin_command(*quote.book_, [&]{
+                const QuoteSide& bid = quote.quote_.bid_;
+                const QuoteSide& ask = quote.quote_.ask_;
+                return std::format("quote {} {} {} {} {} {} {} {}", account, static_cast<int>(stp),
+                    bid.orderId_, bid.price_, bid.quantity_, ask.orderId_, ask.price_, ask.quantity_);
+            });
+            Result<QuoteAck> ack = quote.book_->book_.UpdateQuote(quote.quote_);
+            if (!ack){
+                // the books before this one have been updated and can't be taken back. the record stays in the journal:
+                // UpdateQuote() may have expired orders before it refused, and a replica running the same record at the
+                // same time does the same and is refused the same way.
+                res.status = 500;
+                res.set_content(std::format(R"({{"error":"Quote refused for {} after the books before it were updated: {}"}})",
+                    quote.book_->name_, OrderErrorName(ack.error())), "application/json");
+                return;
+            }
+            for (OrderId leg : { ack->bidId_, ack->askId_ }){
+                if (leg != 0){
+                    gRouter.Record(leg, quote.id_);
+                }
+            }
+            body += std::format(R"({}{{"book": "{}", "bid": {}, "ask": {}, "trades": {}}})", &quote == &quotes.front() ? "" : ", ",
+                quote.book_->name_, ack->bidId_, ack->askId_, ack->trades_.size());
+        }
+        body += "]}";
+        tTrace.MarkEngineEnd();
+
+        res.status = 200;
+        res.set_content(body, "application/json");
+    }catch(const std::exception& e){
+        res.status = 500;
+        std::cerr << "Error in server_quote: " << e.what() << std::endl;
+        res.set_content(std::format(R"({{"error":"Engine error during processing: {}"}})", e.what()), "application/json");
+    }
+}
+
+// POST /cancelall, the kill switch. cancels every order in the book (book=* for every book) that matches all of the optional
+// side, minprice/maxprice (inclusive) and account filters, stops included.
+void server_cancel_all(const httplib::Request& req, httplib::Response& res) {
+    tTrace.endpoint_ = &gCancelAllMetrics;
+    try{
+        string s_book = req.get_param_value("book");
+        if (s_book.empty()){
+            res.status = 400;
+            res.set_content(R"({"error":"Missing required parameters"})", "application/json");
+            return;
+        }
+
+        MassCancelFilter filter;
+        if (req.has_param("side")){
+            filter.side_ = parse_side(req.get_param_value("side"));
+        }
+        if (req.has_param("minprice")){
+            filter.minPrice_ = parse_price(req.get_param_value("minprice"));
+        }
+        if (req.has_param("maxprice")){
+            filter.maxPrice_ = parse_price(req.get_param_value("maxprice"));
+        }
+        if (req.has_param("account")){
+            unsigned long account = std::stoul(req.get_param_value("account"));
+            if (account > MaxAccountId){
+                res.status = 400;
+                res.set_content(std::format(R"({{"error":"account must be between 0 and {}"}})", MaxAccountId), "application/json");
+                return;
+            }
+            filter.owner_ = static_cast<AccountId>(account);
+        }
+        tTrace.MarkParsed();
+
+        // filters that aren't set are journaled as "-".
+        auto describe = [&filter]{
+            auto field = [](const auto& value){ return value ? std::to_string(static_cast<long long>(*value)) : string("-"); };
+            std::optional<int> side;
+            if (filter.side_){
+                side = static_cast<int>(*filter.side_);
+            }
+            return std::format("cancelall {} {} {} {}", field(side), field(filter.minPrice_), field(filter.maxPrice_), field(filter.owner_));
+        };
+
+        std::size_t cancelled = 0;
+        if (s_book == "*"){
+            // one book at a time, a kill switch doesn't need every book frozen at once.
+            gBooks.ForEach([&](Book& entry){
+                std::lock_guard<std::mutex> lock(entry.lock_);
+                begin_command(entry, describe);
+                cancelled += entry.book_.CancelOrders(filter);
+            });
+        }else{
+            Book* entry = find_book(s_book);
+            if (entry == nullptr){
+                res.status = 404;
+                res.set_content(R"({"message": "Book not found"})", "application/json");
+                return;
+            }
+            std::lock_guard<std::mutex> lock(entry->lock_);
+            tTrace.MarkLocked();
+            begin_command(*entry, describe);
+            tTrace.MarkEngineStart();
+            cancelled = entry->book_.CancelOrders(filter);
+            tTrace.MarkEngineEnd();
+        }
+
+        res.status = 200;
+        res.set_content(std::format(R"({{"message": "Orders cancelled", "cancelled": {}}})", cancelled), "application/json");
+    }catch(const std::exception& e){
+        res.status = 500;
+        std::cerr << "Error in server_cancel_all: " << e.what() << std::endl;
+        res.set_content(std::format(R"({{"error":"Engine error during processing: {}"}})", e.what()), "application/json");
+    }
+}
+
+// POST /auction, action=open starts a call auction on the book, action=uncross ends it.
+void server_auction(const httplib::Request& req, httplib::Response& res) {
+    try{
+        string s_book = req.get_param_value("book");
+        string s_action = req.get_param_value("action");
+
+        if (s_book.empty() || (s_action != "open" && s_action != "uncross")){
+            res.status = 400;
+            res.set_content(R"({"error":"Missing required parameters: book, and action=open or action=uncross"})", "application/json");
+            return;
+        }
+
+        Book* entry = find_book(s_book);
+        if (entry == nullptr){
+            res.status = 404;
+            res.set_content(R"({"message": "Book not found"})", "application/json");
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(entry->lock_);
+        Orderbook& book = entry->book_;
+        begin_command(*entry, [&]{ return "auction " + s_action; });
+
+        if (s_action == "open"){
+            book.OpenAuction();
+            res.status = 200;
+            res.set_content(R"({"message": "Auction opened"})", "application/json");
+            return;
+        }
+
+        Result<Trades> result = book.UncrossAuction();
+        if (!result){
+            res.status = order_error_status(result.error());
+            res.set_content(std::format(R"({{"error":"{}"}})", OrderErrorName(result.error())), "application/json");
+            return;
+        }
+        Trades& trades = *result;
+        // a closing uncross can execute more than a Quantity holds in total.
+        std::uint64_t volume = 0;
+        for (auto& trade : trades){
+            volume += trade.GetBidTrade().quantity_;
+        }
+        std::optional<Price> price = book.GetLastTradePrice();
+        res.status = 200;
+        res.set_content(std::format(R"({{"message": "Auction uncrossed", "price": {}, "volume": {}, "trades": {}}})",
+            trades.empty() || !price ? "null" : std::to_string(*price), volume, trades.size()), "application/json");
+    }catch(const std::exception& e){
+        res.status = 500;
+        std::cerr << "Error in server_auction: " << e.what() << std::endl;
+        res.set_content(std::format(R"({{"error":"Engine error during processing: {}"}})", e.what()), "application/json");
+    }
+}
+
+// GET /auction?book=, the book's phase and the indicative uncross price/volume while it is calling.
+void server_auction_status(const httplib::Request& req, httplib::Response& res) {
+    try{
+        string s_book = req.get_param_value("book");
+        if (s_book.empty()){
+            res.status = 400;
+            res.set_content(R"({"error":"Missing required parameters"})", "application/json");
+            return;
+        }
+
+        Book* entry = find_book(s_book);
+        if (entry == nullptr){
+            res.status = 404;
+            res.set_content(R"({"message": "Book not found"})", "application/json");
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(entry->lock_);
+        const Orderbook& book = entry->book_;
+        AuctionIndicative indicative = book.GetAuctionIndicative();
+        res.status = 200;
+        res.set_content(std::format(R"({{"phase": "{}", "price": {}, "volume": {}, "imbalance": {}}})",
+            book.GetPhase() == TradingPhase::Auction ? "auction" : "continuous",
+            indicative.price_ ? std::to_string(*indicative.price_) : "null",
+            indicative.volume_, indicative.imbalance_), "application/json");
+    }catch(const std::exception& e){
+        res.status = 500;
+        std::cerr << "Error in server_auction_status: " << e.what() << std::endl;
+        res.set_content(std::format(R"({{"error":"Engine error getting auction status: {}"}})", e.what()), "application/json");
+    }
+}
+
+// POST /risk sets the limits for every book (new books pick them up too). any limit that isn't passed is left unchanged,
+// 0 turns a limit off.
+void server_risk_limits(const httplib::Request& req, httplib::Response& res) {
+    try{
+        std::lock_guard<std::mutex> lock(gRiskLock);
+        RiskLimits limits = gRiskLimits;
+        if (req.has_param("maxqty")){ limits.maxOrderQuantity_ = parse_quantity(req.get_param_value("maxqty")); }
+        if (req.has_param("maxnotional")){ limits.maxOrderNotional_ = std::stoull(req.get_param_value("maxnotional")); }
+        if (req.has_param("maxopenorders")){ limits.maxOpenOrders_ = static_cast<std::uint32_t>(std::stoul(req.get_param_value("maxopenorders"))); }
+        if (req.has_param("maxposition")){ limits.maxPosition_ = std::stoull(req.get_param_value("maxposition")); }
+        if (req.has_param("maxexposure")){ limits.maxExposure_ = std::stoull(req.get_param_value("maxexposure")); }
+
+        if (gJournal.Enabled()){
+            tJournaled = gJournal.Append(std::format("{} - limits {} {} {} {} {}", SystemClockNow(), limits.maxOrderQuantity_,
+                limits.maxOrderNotional_, limits.maxOpenOrders_, limits.maxPosition_, limits.maxExposure_));
+        }
+        gRiskLimits = limits;
+        gBooks.ForEach([&limits](Book& entry){
+            std::lock_guard<std::mutex> bookLock(entry.lock_);
+            entry.book_.SetRiskLimits(limits);
+        });
+        res.status = 200;
+        res.set_content(std::format(R"({{"maxqty": {}, "maxnotional": {}, "maxopenorders": {}, "maxposition": {}, "maxexposure": {}}})",
+            limits.maxOrderQuantity_, limits.maxOrderNotional_, limits.maxOpenOrders_, limits.maxPosition_, limits.maxExposure_), "application/json");
+    }catch(const std::exception& e){
+        res.status = 400;
+        res.set_content(std::format(R"({{"error":"Invalid risk limit: {}"}})", e.what()), "application/json");
+    }
+}
+
+// GET /risk?book=&account=, the counters the pre-trade check sees for one account in one book.
+void server_risk_account(const httplib::Request& req, httplib::Response& res) {
+    try{
+        string s_book = req.get_param_value("book");
+        string s_account = req.get_param_value("account");
+        if (s_book.empty() || s_account.empty()){
+            res.status = 400;
+            res.set_content(R"({"error":"Missing required parameters"})", "application/json");
+            return;
+        }
+
+        Book* entry = find_book(s_book);
+        if (entry == nullptr){
+            res.status = 404;
+            res.set_content(R"({"message": "Book not found"})", "application/json");
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(entry->lock_);
+        AccountRisk account = entry->book_.GetAccountRisk(static_cast<AccountId>(std::stoul(s_account)));
+        res.status = 200;
+        res.set_content(std::format(R"({{"openorders": {}, "position": {}, "openbuy": {}, "opensell": {}, "opennotional": {}}})",
+            account.openOrders_, account.position_, account.openBuyQuantity_, account.openSellQuantity_, account.openNotional_), "application/json");
+    }catch(const std::exception& e){
+        res.status = 500;
+        res.set_content(std::format(R"({{"error":"Engine error getting risk: {}"}})", e.what()), "application/json");
+    }
+}
+
+// POST /books, interns a new symbol so it can be traded. adding a symbol that already exists is not an error.
+void server_add_book(const httplib::Request& req, httplib::Response& res) {
+    string s_book = req.get_param_value("book");
+    if (!valid_symbol(s_book)){
+        res.status = 400;
+        res.set_content(R"({"error":"book must be 1-32 characters of A-Z, a-z, 0-9, '.', '-' or '_'"})", "application/json");
+        return;
+    }
+
+    auto [id, added] = add_book(s_book);
+    if (id == BookRegistry::InvalidBook){
+        res.status = 507;
+        res.set_content(std::format(R"({{"error":"Book registry is full, the limit is {} books"}})", BookRegistry::MaxBooks), "application/json");
+        return;
+    }
+    res.status = added ? 201 : 200;
+    res.set_content(std::format(R"({{"message": "{}", "id": {}}})", added ? "Book added" : "Book already exists", id), "application/json");
+}
+
+std::string level_infos_to_json(const OrderBookLevelInfo& info, size_t size) {
+    auto convert_levels = [](const LevelInfos& levels, const std::string& type) {
+        std::string json_array = "[";
+        bool first = true;
+        for (const auto& level : levels) {
+            if (!first) {
+                json_array += ",";
+            }
+            json_array += std::format(
+                R"({{"type":"{}", "price":{}, "quantity":{}}})",
+                type, level.price_, level.quantity_
+            );
+            first = false;
+        }
+        json_array += "]";
+        return json_array;
+    };
+
+    return std::format(
+        R"({{"bids":{}, "asks":{}, "size":{}}})",
+        convert_levels(info.GetBids(), "Bid"),
+        convert_levels(info.GetAsks(), "Ask"),
+        size
+    );
+}
+
+// NOTE: This relies on the OrderBookLevelInfo, LevelInfos, Price, and Quantity types being correctly defined earlier in Server.cpp.
+
+std::string all_orderbooks_to_json() {
+    std::string json_output = "{";
+    bool first = true;
+    
+    // gBooks is the global registry, each book is locked only while its own levels are copied out
+    gBooks.ForEach([&](Book& entry) { 
+        if (!first) {
+            json_output += ",";
+        }
+        std::string book_json_content;
+        {
+            std::lock_guard<std::mutex> lock(entry.lock_);
+            const Orderbook& book = entry.book_;
+
+            // Uses the existing utility to get the JSON for one book
+            book_json_content = level_infos_to_json(book.GetOrderInfos(), book.Size());
+        }
+        
+        // Format the book name as the key, and insert the book's JSON content
+        // We remove the outer braces from book_json_content to embed it correctly
+        json_output += std::format(R"("{}":{})", entry.name_, book_json_content);
+        first = false;
+    });
+    json_output += "}";
+    return json_output;
+}
+
+void server_status(const httplib::Request& req, httplib::Response& res) {
+    tTrace.endpoint_ = &gStatusMetrics;
+    try {
+        tTrace.MarkEngineStart();
+        std::string status_json = all_orderbooks_to_json();
+        tTrace.MarkEngineEnd();
 
         res.set_content(status_json, "application/json");
         res.status = 200;
@@ -639,16 +1055,636 @@ void server_status(const httplib::Request& req, httplib::Response& res) {
     }
 }
 
+// one book's best bid/ask and last trade, null for a side (or a last trade) that isn't there.
+std::string top_of_book_to_json(const TopOfBook& top){
+    auto level = [](Price price, Quantity quantity){
+        return quantity == 0 ? std::string("null") : std::format(R"({{"price": {}, "quantity": {}}})", price, quantity);
+    };
+    return std::format(R"({{"bid": {}, "ask": {}, "last": {}}})", level(top.bidPrice_, top.bidQuantity_),
+        level(top.askPrice_, top.askQuantity_), level(top.lastTradePrice_, top.lastTradeQuantity_));
+}
+
+// GET /bbo?book= for one book, GET /bbo for every book. reads each book's published top of book, so it never takes a
+// book's lock and never waits on (or holds up) trading.
+void server_bbo(const httplib::Request& req, httplib::Response& res) {
+    tTrace.endpoint_ = &gBboMetrics;
+    try{
+        string s_book = req.get_param_value("book");
+        tTrace.MarkParsed();
+        tTrace.MarkEngineStart();
+        string body;
+        if (!s_book.empty()){
+            Book* entry = find_book(s_book);
+            if (entry == nullptr){
+                res.status = 404;
+                res.set_content(R"({"message": "Book not found"})", "application/json");
+                return;
+            }
+            body = top_of_book_to_json(entry->book_.GetTopOfBook());
+        }else{
+            body = "{";
+            gBooks.ForEach([&body](const Book& entry){
+                body += std::format(R"({}"{}": {})", body.size() == 1 ? "" : ",", entry.name_, top_of_book_to_json(entry.book_.GetTopOfBook()));
+            });
+            body += "}";
+        }
+        tTrace.MarkEngineEnd();
+
+        res.status = 200;
+        res.set_content(body, "application/json");
+    }catch(const std::exception& e){
+        res.status = 500;
+        std::cerr << "Error in server_bbo: " << e.what() << std::endl;
+        res.set_content(std::format(R"({{"error":"Engine error getting top of book: {}"}})", e.what()), "application/json");
+    }
+}
+
+// GET /order?id=&book= is where an order stands: its state, fills, and how many orders (and how much quantity) are
+// ahead of it at its price. book is optional like on /cancel. finished orders are remembered for a while, not forever.
+void server_order_status(const httplib::Request& req, httplib::Response& res) {
+    try{
+        string s_orderid = req.get_param_value("id");
+        string s_book = req.get_param_value("book");
+        if (s_orderid.empty()){
+            res.status = 400;
+            res.set_content(R"({"error":"Missing required parameters"})", "application/json");
+            return;
+        }
+        OrderId id = parse_id(s_orderid);
+
+        Book* entry = route_order(s_book, id);
+        if (entry == nullptr){
+            res.status = 404;
+            res.set_content(s_book.empty() ? R"({"message": "Order ID not found"})" : R"({"message": "Book not found"})", "application/json");
+            return;
+        }
+
+        Result<OrderStatus> status;
+        {
+            std::lock_guard<std::mutex> lock(entry->lock_);
+            status = entry->book_.GetOrderStatus(id);
+        }
+        if (!status){
+            res.status = 404;
+            res.set_content(R"({"message": "Order ID not found"})", "application/json");
+            return;
+        }
+        res.status = 200;
+        res.set_content(std::format(R"({{"orderid": {}, "book": "{}", "state": "{}", "side": "{}", "price": {}, "quantity": {}, "filled": {}, "remaining": {}, "ordersahead": {}, "quantityahead": {}}})",
+            status->orderId_, entry->name_, OrderStateName(status->state_), status->side_ == Side::Buy ? "BUY" : "SELL", status->price_,
+            status->initial_, status->filled_, status->remaining_, status->ordersAhead_, status->quantityAhead_), "application/json");
+    }catch(const std::exception& e){
+        res.status = 500;
+        std::cerr << "Error in server_order_status: " << e.what() << std::endl;
+        res.set_content(std::format(R"({{"error":"Engine error getting order status: {}"}})", e.what()), "application/json");
+    }
+}
+
+// GET /trades?book=&since=&limit= is the book's executions from sequence "since" on (0, the default, is as far back as the
+// tape goes), GET /trades?book=&time=&limit= the ones from a time (ms since the epoch) on. like /bbo it reads without
+// taking the book's lock. "next" is the sequence to ask for next time, so a poller never misses or repeats a trade.
+void server_trades(const httplib::Request& req, httplib::Response& res) {
+    try{
+        string s_book = req.get_param_value("book");
+        string s_since = req.get_param_value("since");
+        string s_time = req.get_param_value("time");
+        string s_limit = req.get_param_value("limit");
+        if (s_book.empty() || (!s_since.empty() && !s_time.empty())){
+            res.status = 400;
+            res.set_content(R"({"error":"book and at most one of since or time are required"})", "application/json");
+            return;
+        }
+
+        Book* entry = find_book(s_book);
+        if (entry == nullptr){
+            res.status = 404;
+            res.set_content(R"({"message": "Book not found"})", "application/json");
+            return;
+        }
+
+        const Orderbook& book = entry->book_;
+        std::uint64_t from = s_time.empty() ? (s_since.empty() ? 0 : std::stoull(s_since)) : book.FindTrade(std::stoll(s_time));
+        std::size_t limit = s_limit.empty() ? 1000 : std::stoull(s_limit);
+        std::uint64_t end = book.GetTradeCount(); // read first, so a trade landing after the copy is never skipped.
+        std::vector<TapeTrade> trades = book.GetTrades(from, limit);
+
+        string body = "{\"trades\": [";
+        for (const TapeTrade& trade : trades){
+            body += std::format(R"({}{{"seq": {}, "time": {}, "price": {}, "quantity": {}, "aggressor": "{}", "buyorderid": {}, "sellorderid": {}, "auction": {}}})",
+                &trade == trades.data() ? "" : ",", trade.sequence_, trade.timestamp_, trade.price_, trade.quantity_,
+                trade.aggressor_ == Side::Buy ? "BUY" : "SELL", trade.buyOrderId_, trade.sellOrderId_, trade.auction_);
+        }
+        body += std::format(R"(], "next": {}}})", trades.empty() ? std::min(from, end) : trades.back().sequence_ + 1);
+
+        res.status = 200;
+        res.set_content(body, "application/json");
+    }catch(const std::exception& e){
+        res.status = 500;
+        std::cerr << "Error in server_trades: " << e.what() << std::endl;
+        res.set_content(std::format(R"({{"error":"Engine error getting trades: {}"}})", e.what()), "application/json");
+    }
+}
+
+// GET /candles?book=&interval=&from=&limit= is the latest OHLCV bars of one of the book's candle intervals (1s, 1m and 5m
+// unless ORDERBOOK_CANDLES says otherwise), oldest first, optionally only those starting at or after "from" (ms).
+void server_candles(const httplib::Request& req, httplib::Response& res) {
+    try{
+        string s_book = req.get_param_value("book");
+        string s_interval = req.get_param_value("interval");
+        string s_from = req.get_param_value("from");
+        string s_limit = req.get_param_value("limit");
+        if (s_book.empty() || s_interval.empty()){
+            res.status = 400;
+            res.set_content(R"({"error":"book and interval are required"})", "application/json");
+            return;
+        }
+        Timestamp interval = parse_interval(s_interval);
+        Timestamp from = s_from.empty() ? std::numeric_limits<Timestamp>::min() : std::stoll(s_from);
+        std::size_t limit = s_limit.empty() ? 100 : std::stoull(s_limit);
+
+        Book* entry = find_book(s_book);
+        if (entry == nullptr){
+            res.status = 404;
+            res.set_content(R"({"message": "Book not found"})", "application/json");
+            return;
+        }
+
+        std::optional<std::vector<Candle>> candles;
+        {
+            std::lock_guard<std::mutex> lock(entry->lock_);
+            candles = entry->book_.GetCandles(interval, from, limit);
+        }
+        if (!candles){
+            res.status = 404;
+            res.set_content(std::format(R"({{"message": "No {}ms candles are kept"}})", interval), "application/json");
+            return;
+        }
+
+        string body = std::format(R"({{"interval": {}, "candles": [)", interval);
+        for (const Candle& bar : *candles){
+            body += std::format(R"({}{{"start": {}, "open": {}, "high": {}, "low": {}, "close": {}, "volume": {}, "vwap": {:.4f}, "trades": {}}})",
+                &bar == candles->data() ? "" : ",", bar.start_, bar.open_, bar.high_, bar.low_, bar.close_, bar.volume_,
+                static_cast<double>(bar.notional_) / static_cast<double>(bar.volume_), bar.trades_);
+        }
+        body += "]}";
+
+        res.status = 200;
+        res.set_content(body, "application/json");
+    }catch(const std::invalid_argument&){
+        res.status = 400;
+        res.set_content(R"({"error":"interval, from and limit must be numbers, interval may end in ms, s, m or h"})", "application/json");
+    }catch(const std::exception& e){
+        res.status = 500;
+        std::cerr << "Error in server_candles: " << e.what() << std::endl;
+        res.set_content(std::format(R"({{"error":"Engine error getting candles: {}"}})", e.what()), "application/json");
+    }
+}
+
+// GET /liquidity?book=&side=&quantity= is what a market order of that side and size would fill right now (quantity,
+// average and worst price), GET /liquidity?book=&side=&price= is how much it could take with that limit price.
+// both only count displayed quantity and are O(log levels) in the engine.
+void server_liquidity(const httplib::Request& req, httplib::Response& res) {
+    try{
+        string s_book = req.get_param_value("book");
+        string s_side = req.get_param_value("side");
+        string s_quantity = req.get_param_value("quantity");
+        string s_price = req.get_param_value("price");
+        if (s_book.empty() || s_side.empty() || s_quantity.empty() == s_price.empty()){
+            res.status = 400;
+            res.set_content(R"({"error":"book, side and one of quantity or price are required"})", "application/json");
+            return;
+        }
+        Side side = parse_side(s_side);
+
+        Book* entry = find_book(s_book);
+        if (entry == nullptr){
+            res.status = 404;
+            res.set_content(R"({"message": "Book not found"})", "application/json");
+            return;
+        }
+
+        if (!s_price.empty()){
+            Price limit = parse_price(s_price);
+            std::uint64_t available;
+            {
+                std::lock_guard<std::mutex> lock(entry->lock_);
+                available = entry->book_.QuantityAvailable(side, limit);
+            }
+            res.status = 200;
+            res.set_content(std::format(R"({{"price": {}, "available": {}}})", limit, available), "application/json");
+            return;
+        }
+
+        Quantity quantity = parse_quantity(s_quantity);
+        FillEstimate estimate;
+        {
+            std::lock_guard<std::mutex> lock(entry->lock_);
+            estimate = entry->book_.EstimateFill(side, quantity);
+        }
+        res.status = 200;
+        res.set_content(std::format(R"({{"requested": {}, "filled": {}, "notional": {}, "average": {}, "worst": {}}})",
+            quantity, estimate.quantity_, estimate.notional_,
+            estimate.quantity_ == 0 ? "null" : std::format("{:.4f}", static_cast<double>(estimate.notional_) / static_cast<double>(estimate.quantity_)),
+            estimate.worstPrice_ ? std::to_string(*estimate.worstPrice_) : "null"), "application/json");
+    }catch(const std::exception& e){
+        res.status = 500;
+        std::cerr << "Error in server_liquidity: " << e.what() << std::endl;
+        res.set_content(std::format(R"({{"error":"Engine error getting liquidity: {}"}})", e.what()), "application/json");
+    }
+}
+
+// Prometheus text exposition of every latency histogram. quantiles are reported in seconds, as Prometheus expects.
+std::string metrics_to_prometheus() {
+    std::string out;
+
+    auto write_summary = [&out](const std::string& metric, const std::string& labels, const LatencyHistogram& histogram){
+        for (double quantile : {0.5, 0.99, 0.999}){
+            out += std::format("{}{{{},quantile=\"{}\"}} {:.9f}\n", metric, labels, quantile, histogram.Percentile(quantile) / 1e9);
+        }
+        out += std::format("{}_sum{{{}}} {:.9f}\n", metric, labels, histogram.Sum() / 1e9);
+        out += std::format("{}_count{{{}}} {}\n", metric, labels, histogram.Count());
+    };
+
+    out += "# HELP orderbook_request_latency_seconds Engine-side request latency by endpoint and stage.\n";
+    out += "# TYPE orderbook_request_latency_seconds summary\n";
+    for (const EndpointMetrics* endpoint : {&gTradeMetrics, &gCancelMetrics, &gModifyMetrics, &gQuoteMetrics, &gCancelAllMetrics, &gStatusMetrics, &gBboMetrics}){
+        write_summary("orderbook_request_latency_seconds", std::format(R"(endpoint="{}",stage="parse")", endpoint->name_), endpoint->parse_);
+        write_summary("orderbook_request_latency_seconds", std::format(R"(endpoint="{}",stage="lock_wait")", endpoint->name_), endpoint->lockWait_);
+        write_summary("orderbook_request_latency_seconds", std::format(R"(endpoint="{}",stage="engine")", endpoint->name_), endpoint->engine_);
+        write_summary("orderbook_request_latency_seconds", std::format(R"(endpoint="{}",stage="total")", endpoint->name_), endpoint->total_);
+    }
+
+    // the registry is walked lock-free and book addresses are stable, only reading a book's size takes its lock.
+    std::vector<std::pair<string, const BookMetrics*>> books;
+    std::vector<std::pair<string, std::size_t>> sizes;
+    gBooks.ForEach([&](Book& entry){
+        books.emplace_back(entry.name_, &entry.metrics_);
+        std::lock_guard<std::mutex> lock(entry.lock_);
+        sizes.emplace_back(entry.name_, entry.book_.Size());
+    });
+
+    out += "# HELP orderbook_match_latency_seconds Time spent inside Orderbook::AddOrder, per book.\n";
+    out += "# TYPE orderbook_match_latency_seconds summary\n";
+    for (const auto& [name, metrics] : books){
+        write_summary("orderbook_match_latency_seconds", std::format(R"(book="{}")", name), metrics->match_);
+    }
+
+    out += "# HELP orderbook_lock_wait_seconds Time spent waiting for the book's lock.\n";
+    out += "# TYPE orderbook_lock_wait_seconds summary\n";
+    for (const auto& [name, metrics] : books){
+        write_summary("orderbook_lock_wait_seconds", std::format(R"(book="{}")", name), metrics->lockWait_);
+    }
+
+    out += "# HELP orderbook_resting_orders Number of live orders in the book.\n";
+    out += "# TYPE orderbook_resting_orders gauge\n";
+    for (const auto& [name, size] : sizes){
+        out += std::format("orderbook_resting_orders{{book=\"{}\"}} {}\n", name, size);
+    }
+    return out;
+}
+
+void server_metrics(const httplib::Request& req, httplib::Response& res) {
+    try {
+        res.set_content(metrics_to_prometheus(), "text/plain; version=0.0.4");
+        res.status = 200;
+    } catch (const std::exception& e) {
+        res.status = 500;
+        std::cerr << "Exception in server_metrics: " << e.what() << std::endl;
+        res.set_content(std::format(R"({{"error":"Engine error getting metrics: {}"}})", e.what()), "application/json");
+    }
+}
+
+// the replica's half of the journal: runs one record ("time book op args...", as begin_command() wrote it) on this
+// server's books the way the primary did, and journals it again so the replica can have a replica of its own once promoted.
+void apply_record(const string& record){
+    std::istringstream fields(record);
+    Timestamp time = 0;
+    string s_book, op;
+    fields >> time >> s_book >> op;
+
+    if (op == "book"){
+        string name;
+        fields >> name;
+        std::lock_guard<std::mutex> lock(gRiskLock);
+        gJournal.Append(record);
+        BookId id = gBooks.Add(name, gRiskLimits, gCandleIntervals, time).first;
+        if (id != std::stoul(s_book)){
+            // every later record for this id would land on the wrong book.
+            throw std::runtime_error(std::format("interned {} as book {}, the primary has it as {}", name, id, s_book));
+        }
+        return;
+    }
+    if (op == "limits"){
+        RiskLimits limits;
+        fields >> limits.maxOrderQuantity_ >> limits.maxOrderNotional_ >> limits.maxOpenOrders_ >> limits.maxPosition_ >> limits.maxExposure_;
+        std::lock_guard<std::mutex> lock(gRiskLock);
+        gJournal.Append(record);
+        gRiskLimits = limits;
+        gBooks.ForEach([&limits](Book& entry){
+            std::lock_guard<std::mutex> bookLock(entry.lock_);
+            entry.book_.SetRiskLimits(limits);
+        });
+        return;
+    }
+
+    BookId id = static_cast<BookId>(std::stoul(s_book));
+    if (id >= gBooks.Size()){
+        throw std::invalid_argument("unknown book " + s_book);
+    }
+    Book& entry = gBooks.Get(id);
+    std::lock_guard<std::mutex> lock(entry.lock_);
+    gJournal.Append(record);
+    Orderbook& book = entry.book_;
+
+    if (op == "check"){
+        std::uint64_t expected = 0;
+        fields >> expected;
+        if (book.Checksum() == expected){
+            gChecksPassed.fetch_add(1, std::memory_order_relaxed);
+        }else{
+            // the book has drifted from the primary's, so nothing applied after this can be trusted either.
+            gChecksFailed.fetch_add(1, std::memory_order_relaxed);
+            gDiverged = true;
+            std::cerr << "Replica diverged, checksum mismatch in " << entry.name_ << " at journal record " << gJournal.Next() - 1
+                << ", it has stopped following the primary" << std::endl;
+        }
+        return;
+    }
+
+    entry.now_ = time;
+    if (!ApplyBookRecord(book, op, fields, [id](OrderId orderId){ gRouter.Record(orderId, id); })){
+        throw std::invalid_argument("malformed journal record, or unknown op " + op);
+    }
+}
+
+// the replica's follower thread: polls the primary's journal from where this server's own journal ends (which also
+// acknowledges everything before it) and applies what comes back, until POST /promote clears gFollowing or the replica
+// diverges.
+void follow_primary(string host, int port){
+    httplib::Client primary(host, port);
+    primary.set_read_timeout(std::chrono::seconds(5));
+    // what went wrong with the last poll, so a primary that stays down is only logged once.
+    string problem = "not connected";
+    while (gFollowing.load() && !gDiverged.load()){
+        std::uint64_t from = gJournal.Next();
+        auto response = primary.Get("/journal", httplib::Params{ { "from", std::to_string(from) }, { "wait", "500" } }, httplib::Headers{ });
+        if (response && response->status == 410){
+            // the records it needs are gone, polling again can't bring them back.
+            std::cerr << "Replica diverged, the primary at " << host << ":" << port << " no longer has journal record " << from
+                << ": " << response->body << std::endl;
+            gDiverged = true;
+            break;
+        }
+        if (!response || response->status != 200){
+            string now = response ? response->body : httplib::to_string(response.error());
+            if (now != problem){
+                std::cerr << "Can't follow the primary at " << host << ":" << port << ": " << now << std::endl;
+                problem = now;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            continue;
+        }
+        if (!problem.empty()){
+            std::cout << "\n Following the primary at " << host << ":" << port << " from journal record " << from << std::endl;
+            problem.clear();
+        }
+
+        const string& body = response->body;
+        for (std::size_t start = 0, end; (end = body.find('\n', start)) != string::npos; start = end + 1){
+            // the record that failed would be asked for again on the next poll and fail the same way, so a failure ends
+            // following for good instead.
+            const std::uint64_t expected = gJournal.Next();
+            try{
+                std::size_t space = body.find(' ', start);
+                std::uint64_t seq = std::stoull(body.substr(start, space - start));
+                if (seq != expected){
+                    std::cerr << "Journal record " << seq << " arrived out of order, expected " << expected << std::endl;
+                    break;
+                }
+                apply_record(body.substr(space + 1, end - space - 1));
+                if (gDiverged.load()){
+                    break;
+                }
+            }catch(const std::exception& e){
+                std::cerr << "Replica diverged, it could not apply journal record " << expected << " (" << e.what()
+                    << ") and has stopped following the primary" << std::endl;
+                gDiverged = true;
+                break;
+            }
+        }
+    }
+}
+
+// GET /journal?from=&wait= is what a replica polls: the journal from sequence "from" on, one "seq time book op args..."
+// line per record, held open for up to "wait" ms (at most 1000) until there is one. asking for "from" acknowledges
+// (and drops) every record before it. 410 once "from" itself has been dropped.
+void server_journal(const httplib::Request& req, httplib::Response& res) {
+    try{
+        if (!gJournal.Enabled()){
+            res.status = 404;
+            res.set_content(R"({"error":"Journaling is off, start the server with ORDERBOOK_REPLICATION=async or sync"})", "application/json");
+            return;
+        }
+        string s_from = req.get_param_value("from");
+        string s_wait = req.get_param_value("wait");
+        std::uint64_t from = s_from.empty() ? 0 : std::stoull(s_from);
+        auto wait = std::chrono::milliseconds(std::min<std::uint64_t>(s_wait.empty() ? 0 : std::stoull(s_wait), 1000));
+        if (from > gJournal.Next()){
+            // the replica has records this journal never had, e.g. it followed a primary that has since restarted.
+            res.status = 409;
+            res.set_content(std::format(R"({{"error":"Journal ends at {}, the replica asked for {}"}})", gJournal.Next(), from), "application/json");
+            return;
+        }
+        std::optional<string> records = gJournal.Read(from, 10000, wait);
+        if (!records){
+            // dropped, either acknowledged by a replica before this one or pushed out by MaxRecords.
+            res.status = 410;
+            res.set_content(std::format(R"({{"error":"Journal now starts at {}, the replica asked for {}"}})", gJournal.First(), from), "application/json");
+            return;
+        }
+        res.status = 200;
+        res.set_content(*records, "text/plain");
+    }catch(const std::exception& e){
+        res.status = 400;
+        res.set_content(std::format(R"({{"error":"Invalid journal request: {}"}})", e.what()), "application/json");
+    }
+}
+
+std::thread gFollower;
+std::mutex gPromoteLock;
+
+// POST /promote makes a replica the primary: it stops following once it has applied what it was last sent, and takes
+// orders from then on, journaling them for a replica of its own. a diverged replica's books don't match its primary's,
+// so it is only promoted with force=1.
+void server_promote(const httplib::Request& req, httplib::Response& res) {
+    std::lock_guard<std::mutex> lock(gPromoteLock);
+    bool force = req.get_param_value("force") == "1";
+    if (!gFollowing.exchange(false)){
+        res.status = 409;
+        res.set_content(R"({"error":"This server is already a primary"})", "application/json");
+        return;
+    }
+    if (gFollower.joinable()){
+        gFollower.join();
+    }
+    if (gDiverged.load() && !force){
+        // the follower has stopped either way, so it stays a replica that takes no orders.
+        gFollowing = true;
+        res.status = 409;
+        res.set_content(R"({"error":"This replica has diverged from its primary, promote it with force=1 to take orders anyway"})", "application/json");
+        return;
+    }
+    std::cout << "\n Promoted to primary at journal record " << gJournal.Next() << (gDiverged.load() ? " despite having diverged" : "") << std::endl;
+    res.status = 200;
+    res.set_content(std::format(R"({{"message": "Promoted to primary", "journal": {}}})", gJournal.Next()), "application/json");
+}
+
+// GET /replication, this server's side of replication: its role, how long its journal is, how much of it a replica has
+// acknowledged, and (on a replica) how many of the primary's checksums matched its own books and whether it has diverged.
+void server_replication(const httplib::Request& req, httplib::Response& res) {
+    const char* mode = gReplicationMode == ReplicationMode::Sync ? "sync" : gReplicationMode == ReplicationMode::Async ? "async" : "off";
+    std::uint64_t next = gJournal.Next();
+    std::uint64_t acked = gJournal.Acked();
+    res.status = 200;
+    res.set_content(std::format(R"({{"role": "{}", "mode": "{}", "journal": {}, "acked": {}, "lag": {}, "synctimeouts": {}, "checks": {}, "mismatches": {}, "diverged": {}}})",
+        gFollowing.load() ? "replica" : "primary", mode, next, acked, next - acked, gSyncTimeouts.load(),
+        gChecksPassed.load(), gChecksFailed.load(), gDiverged.load()), "application/json");
+}
+
 int main() {
-    // we currently access "MyMap" in all functions, which we know may run concurrently. This can be a race condition (trade + cancel at the same time).
+    // every handler may run concurrently, each book is guarded by its own lock and the registry itself is read lock-free.
     httplib::Server svr;
+    TickClock::Calibrate();
+
+    if (const char* candles = std::getenv("ORDERBOOK_CANDLES"); candles != nullptr){
+        gCandleIntervals.clear();
+        string intervalList = candles;
+        for (std::size_t start = 0; start < intervalList.size(); ){
+            std::size_t end = std::min(intervalList.find(',', start), intervalList.size());
+            string interval = intervalList.substr(start, end - start);
+            try{
+                gCandleIntervals.push_back(parse_interval(interval));
+            }catch(const std::exception&){
+                std::cerr << "Skipping invalid candle interval: " << interval << std::endl;
+            }
+            start = end + 1;
+        }
+    }
+
+    const char* portValue = std::getenv("ORDERBOOK_PORT");
+    int port = portValue != nullptr ? std::stoi(portValue) : 6060;
+
+    // ORDERBOOK_REPLICATION=async|sync journals every command, ORDERBOOK_ROLE=replica follows ORDERBOOK_PRIMARY (host:port,
+    // localhost:6060 by default). a replica always journals, so it can be promoted, asynchronously unless told otherwise.
+    const char* modeValue = std::getenv("ORDERBOOK_REPLICATION");
+    string mode = modeValue != nullptr ? modeValue : "off";
+    gReplicationMode = mode == "sync" ? ReplicationMode::Sync : mode == "async" ? ReplicationMode::Async : ReplicationMode::Off;
+    const char* role = std::getenv("ORDERBOOK_ROLE");
+    bool replica = role != nullptr && string(role) == "replica";
+    if (replica && gReplicationMode == ReplicationMode::Off){
+        gReplicationMode = ReplicationMode::Async;
+    }
+    if (gReplicationMode != ReplicationMode::Off){
+        gJournal.Enable();
+    }
+
+    // books must be interned before anyone can trade them, either here or through POST /books. a replica gets its books
+    // from the primary's journal instead.
+    const char* symbols = std::getenv("ORDERBOOK_SYMBOLS");
+    string symbolList = replica ? "" : symbols != nullptr ? symbols : DefaultSymbols;
+    for (std::size_t start = 0; start <= symbolList.size(); ){
+        std::size_t end = symbolList.find(',', start);
+        if (end == string::npos){
+            end = symbolList.size();
+        }
+        string symbol = symbolList.substr(start, end - start);
+        if (!symbol.empty() && add_book(symbol).first == BookRegistry::InvalidBook){
+            std::cerr << "Skipping invalid symbol: " << symbol << std::endl;
+        }
+        start = end + 1;
+    }
+
+    // start the per-thread trace before routing, and close it out once httplib has written the response.
+    svr.set_pre_routing_handler([](const httplib::Request& req, httplib::Response& res){
+        tTrace.Begin();
+        tJournaled = NotJournaled;
+        // a replica's books only change through the journal.
+        if (gFollowing.load() && req.method == "POST" && req.path != "/promote"){
+            res.status = 503;
+            res.set_content(R"({"error":"This server is a replica, send orders to the primary or POST /promote"})", "application/json");
+            return httplib::Server::HandlerResponse::Handled;
+        }
+        return httplib::Server::HandlerResponse::Unhandled;
+    });
+    // sync mode: hold the response until the replica has what this request journaled.
+    svr.set_post_routing_handler([](const httplib::Request&, httplib::Response&){
+        if (gReplicationMode == ReplicationMode::Sync && tJournaled != NotJournaled && !gJournal.WaitForAck(tJournaled, SyncAckTimeout)){
+            gSyncTimeouts.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    svr.set_logger([](const httplib::Request&, const httplib::Response&){
+        tTrace.Finish();
+    });
 
     svr.Post("/trade", server_trade);
     svr.Post("/cancel", server_cancel);
+    svr.Post("/modify", server_modify);
+    svr.Post("/quote", server_quote);
+    svr.Post("/cancelall", server_cancel_all);
     svr.Get("/status", server_status);
+    svr.Get("/bbo", server_bbo);
+    svr.Get("/order", server_order_status);
+    svr.Get("/liquidity", server_liquidity);
+    svr.Get("/trades", server_trades);
+    svr.Get("/candles", server_candles);
+    svr.Get("/metrics", server_metrics);
+    svr.Post("/auction", server_auction);
+    svr.Get("/auction", server_auction_status);
+    svr.Post("/risk", server_risk_limits);
+    svr.Get("/risk", server_risk_account);
+    svr.Post("/books", server_add_book);
+    svr.Get("/journal", server_journal);
+    svr.Get("/replication", server_replication);
+    svr.Post("/promote", server_promote);
+
+    if (replica){
+        const char* primaryValue = std::getenv("ORDERBOOK_PRIMARY");
+        string primary = primaryValue != nullptr ? primaryValue : "localhost:6060";
+        std::size_t colon = primary.rfind(':');
+        string host = colon == string::npos ? primary : primary.substr(0, colon);
+        int primaryPort = colon == string::npos ? 6060 : std::stoi(primary.substr(colon + 1));
+        gFollowing = true;
+        gFollower = std::thread(follow_primary, host, primaryPort);
+    }
+
+    // GFD/GTT orders also expire lazily whenever their book is touched, this sweeper catches books that go quiet.
+    // a sweep moves the book's clock and expiry wheel even when nothing is due, so every sweep is journaled and a replica
+    // runs the same ones at the same times. books with nothing armed are left alone, a sweep would change nothing there.
+    // once a second it also journals the checksum of every book that has changed since the last one. a replica leaves
+    // both to its primary until it is promoted.
+    std::thread expirySweeper([]{
+        for (std::uint64_t sweep = 1; ; sweep++){
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if (gFollowing.load()){
+                continue;
+            }
+            gBooks.ForEach([sweep](Book& entry){
+                std::lock_guard<std::mutex> lock(entry.lock_);
+                if (entry.book_.ArmedExpiries() != 0){
+                    begin_command(entry, []{ return string("expire"); });
+                    entry.book_.ExpireOrders();
+                }
+                if (gJournal.Enabled() && entry.changed_ && sweep % 10 == 0){
+                    entry.changed_ = false;
+                    gJournal.Append(std::format("{} {} check {}", entry.now_, entry.id_, entry.book_.Checksum()));
+                }
+            });
+        }
+    });
+    expirySweeper.detach();
 
-    std::cout << "C++ server listening on http://localhost:6060/run\n";
-    svr.listen("0.0.0.0", 6060);
+    std::cout << "C++ server listening on http://localhost:" << port << "/run\n";
+    svr.listen("0.0.0.0", port);
 
 }
 
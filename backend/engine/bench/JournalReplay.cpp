@@ -0,0 +1,128 @@
+// Replays a journal recorded from a running server (no HTTP) through the same code a replica uses, and reports
+// throughput. It is the training run for PGO builds: a recorded journal is real traffic, with the mix of order types,
+// cancels, quotes, auctions and expiries the server actually sees, which a synthetic flow can only guess at.
+// The primary's checksum records are checked as they go by, so a replay also shows the engine is still deterministic.
+//
+// A journal is what GET /journal returns ("seq time book op args..." lines) from a server started with
+// ORDERBOOK_REPLICATION=async, saved to a file in order. bench/sample.journal is one recorded from mixed traffic.
+//
+// usage: orderbook_replay <journal> [passes]
+
+#include "JournalRecord.h"
+#include "Orderbook.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// one of the server's books, with the clock the journal moves.
+struct ReplayBook{
+    Timestamp now_ = 0;
+    Orderbook book_{ [this]{ return now_; } };
+};
+
+struct Results{
+    std::uint64_t records_ = 0;
+    std::uint64_t checks_ = 0;
+    std::uint64_t mismatches_ = 0;
+    std::uint64_t errors_ = 0;
+};
+
+// every record, in order, from a sequence of GET /journal responses.
+std::vector<std::string> Load(const char* path){
+    std::vector<std::string> records;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)){
+        std::size_t space = line.find(' ');
+        if (space != std::string::npos){
+            records.push_back(line.substr(space + 1));
+        }
+    }
+    return records;
+}
+
+// runs the whole journal once on fresh books.
+void Replay(const std::vector<std::string>& records, Results& results){
+    std::vector<std::unique_ptr<ReplayBook>> books;
+    RiskLimits limits;
+    for (const std::string& record : records){
+        std::istringstream fields(record);
+        Timestamp time = 0;
+        std::string book, op;
+        fields >> time >> book >> op;
+        results.records_++;
+        std::uint64_t id = std::strtoull(book.c_str(), nullptr, 10); // "-" for records that aren't about one book
+
+        if (op == "book"){
+            if (id != books.size()){
+                results.errors_++; // the journal doesn't start at its beginning, or has a gap.
+                continue;
+            }
+            books.push_back(std::make_unique<ReplayBook>());
+            books.back()->now_ = time;
+            books.back()->book_.SetRiskLimits(limits);
+            continue;
+        }
+        if (op == "limits"){
+            fields >> limits.maxOrderQuantity_ >> limits.maxOrderNotional_ >> limits.maxOpenOrders_ >> limits.maxPosition_ >> limits.maxExposure_;
+            for (auto& entry : books){
+                entry->book_.SetRiskLimits(limits);
+            }
+            continue;
+        }
+        if (id >= books.size()){
+            results.errors_++;
+            continue;
+        }
+
+        ReplayBook& entry = *books[id];
+        if (op == "check"){
+            std::uint64_t expected = 0;
+            fields >> expected;
+            results.checks_++;
+            results.mismatches_ += entry.book_.Checksum() != expected;
+            continue;
+        }
+        entry.now_ = time;
+        if (!ApplyBookRecord(entry.book_, op, fields, [](OrderId){ })){
+            results.errors_++;
+        }
+    }
+}
+
+}
+
+int main(int argc, char** argv){
+    if (argc < 2){
+        std::cerr << "usage: orderbook_replay <journal> [passes]\n";
+        return 2;
+    }
+    std::vector<std::string> records = Load(argv[1]);
+    if (records.empty()){
+        std::cerr << std::format("no journal records in {}\n", argv[1]);
+        return 2;
+    }
+    std::uint64_t passes = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1;
+
+    Results results;
+    auto start = std::chrono::steady_clock::now();
+    for (std::uint64_t pass = 0; pass < passes; pass++){
+        Replay(records, results);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::format("records: {} ({} per pass, {} passes), checksums: {} checked, {} mismatched, bad records: {}\n",
+        results.records_, records.size(), passes, results.checks_, results.mismatches_, results.errors_);
+    std::cout << std::format("throughput: {:.0f} records/s\n", results.records_ / seconds);
+    return results.mismatches_ == 0 && results.errors_ == 0 ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+// Drives a single Orderbook directly (no HTTP) with a deterministic, seeded order flow and reports throughput
+// and per-operation latency. It is also the training run for PGO builds, so the mix is meant to look like real
+// traffic: mostly passive limits near the touch, a steady stream of cancels, and some aggressive flow that matches.
+//
+// usage: orderbook_bench [operations] [seed]
+
+#include "Orderbook.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// xorshift64*, so a given seed produces the same flow on every platform (std::uniform_int_distribution doesn't).
+struct Random{
+    std::uint64_t state_;
+
+    std::uint64_t Next(){
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 0x2545F4914F6CDD1Dull;
+    }
+
+    // uniform in [low, high]
+    std::int64_t Between(std::int64_t low, std::int64_t high){
+        return low + static_cast<std::int64_t>(Next() % static_cast<std::uint64_t>(high - low + 1));
+    }
+};
+
+struct Workload{
+    std::uint64_t operations_ = 2'000'000;
+    std::uint64_t seed_ = 42;
+};
+
+struct Results{
+    std::uint64_t adds_ = 0;
+    std::uint64_t cancels_ = 0;
+    std::uint64_t modifies_ = 0;
+    std::uint64_t trades_ = 0;
+    std::vector<std::uint64_t> latencies_;
+};
+
+Results Run(const Workload& workload){
+    Results results;
+    results.latencies_.reserve(workload.operations_);
+
+    // the clock only moves when we say so, so expiry never depends on how fast the run is.
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    Random random{ workload.seed_ | 1 };
+
+    constexpr Price Mid = 10'000;
+    // past this many resting orders every operation is a cancel, so the book settles at a realistic depth instead of growing forever.
+    constexpr std::size_t MaxResting = 50'000;
+    std::vector<OrderId> live;
+    OrderId nextId = 1;
+
+    for (std::uint64_t i = 0; i < workload.operations_; i++){
+        now++;
+        std::uint64_t roll = random.Next() % 100;
+        auto start = std::chrono::steady_clock::now();
+
+        if ((roll < 30 || live.size() >= MaxResting) && !live.empty()){
+            // cancel a random live order (it may already have traded away, which is a no-op like on the server).
+            std::size_t index = random.Next() % live.size();
+            book.CancelOrder(live[index]);
+            live[index] = live.back();
+            live.pop_back();
+            results.cancels_++;
+        }else if (roll < 35 && !live.empty()){
+            OrderId id = live[random.Next() % live.size()];
+            Side side = random.Next() & 1 ? Side::Buy : Side::Sell;
+            Price price = static_cast<Price>(Mid + random.Between(-20, 20));
+            if (auto trades = book.MatchOrder(OrderModify{ id, side, price, static_cast<Quantity>(random.Between(1, 500)) })){
+                results.trades_ += trades->size();
+            }
+            results.modifies_++;
+        }else{
+            Side side = random.Next() & 1 ? Side::Buy : Side::Sell;
+            // passive orders sit behind the touch, aggressive ones cross it by a few ticks.
+            bool aggressive = roll >= 85;
+            std::int64_t offset = aggressive ? random.Between(-5, 1) : random.Between(1, 50);
+            Price price = static_cast<Price>(side == Side::Buy ? Mid - offset : Mid + offset);
+            Quantity quantity = static_cast<Quantity>(random.Between(1, 500));
+
+            OrderType type = OrderType::GoodTillCancel;
+            if (roll >= 97){
+                type = OrderType::Market;
+            }else if (roll >= 94){
+                type = OrderType::FillOrKill;
+            }else if (roll >= 90){
+                type = OrderType::FillAndKill;
+            }
+
+            OrderId id = nextId++;
+            auto order = std::make_shared<Order>(type, side, price, quantity, id);
+            if (type == OrderType::GoodTillCancel && roll % 10 == 0){
+                order->SetDisplayQuantity(quantity / 4);
+            }
+            order->SetOwner(static_cast<AccountId>(random.Between(0, 64)), SelfTradePrevention::CancelNewest);
+            if (auto trades = book.AddOrder(order)){
+                results.trades_ += trades->size();
+            }
+            if (type == OrderType::GoodTillCancel){
+                live.push_back(id);
+            }
+            results.adds_++;
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        results.latencies_.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+    return results;
+}
+
+std::uint64_t Percentile(std::vector<std::uint64_t>& sorted, double q){
+    if (sorted.empty()){
+        return 0;
+    }
+    std::size_t index = std::min(sorted.size() - 1, static_cast<std::size_t>(q * static_cast<double>(sorted.size())));
+    return sorted[index];
+}
+
+}
+
+int main(int argc, char** argv){
+    Workload workload;
+    if (argc > 1){
+        workload.operations_ = std::strtoull(argv[1], nullptr, 10);
+    }
+    if (argc > 2){
+        workload.seed_ = std::strtoull(argv[2], nullptr, 10);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Results results = Run(workload);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::sort(results.latencies_.begin(), results.latencies_.end());
+    std::cout << std::format("operations: {} (adds {}, cancels {}, modifies {}), trades: {}\n",
+        workload.operations_, results.adds_, results.cancels_, results.modifies_, results.trades_);
+    std::cout << std::format("throughput: {:.0f} ops/s\n", workload.operations_ / seconds);
+    std::cout << std::format("latency ns: p50 {} p99 {} p99.9 {} max {}\n",
+        Percentile(results.latencies_, 0.5), Percentile(results.latencies_, 0.99),
+        Percentile(results.latencies_, 0.999), results.latencies_.empty() ? 0 : results.latencies_.back());
+    return 0;
+}
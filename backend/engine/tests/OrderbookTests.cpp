@@ -0,0 +1,1174 @@
+// Regression tests for the engine, driven directly (no HTTP). Each test builds a fresh book on a fixed clock and checks
+// the trades and the book left behind. Run through ctest, or on its own: any failed check is printed and the exit
+// status is non-zero.
+
+#include "JournalRecord.h"
+#include "Orderbook.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+int gFailures = 0;
+
+#define CHECK(condition) \
+    do{ \
+        if (!(condition)){ \
+            std::cerr << std::format("{}:{}: CHECK({}) failed\n", __FILE__, __LINE__, #condition); \
+            gFailures++; \
+        } \
+    }while (false)
+
+OrderPointer MakeOrder(OrderType type, Side side, Price price, Quantity quantity, OrderId id,
+    AccountId owner = 0, SelfTradePrevention stp = SelfTradePrevention::CancelNewest){
+    auto order = std::make_shared<Order>(type, side, price, quantity, id);
+    order->SetOwner(owner, stp);
+    return order;
+}
+
+// every level of both sides, so two snapshots of a book can be compared.
+std::vector<std::tuple<Side, Price, Quantity>> Levels(const Orderbook& book){
+    std::vector<std::tuple<Side, Price, Quantity>> levels;
+    OrderBookLevelInfo info = book.GetOrderInfos();
+    for (const auto& level : info.GetBids()){
+        levels.emplace_back(Side::Buy, level.price_, level.quantity_);
+    }
+    for (const auto& level : info.GetAsks()){
+        levels.emplace_back(Side::Sell, level.price_, level.quantity_);
+    }
+    return levels;
+}
+
+// a fill-or-kill that would reach its own account's resting order is decided by the self-trade prevention mode the
+// sweep will use: the cancel-newest modes kill it before anything trades, cancel-oldest only counts the other accounts'
+// liquidity, and decrement counts the own order as quantity used up.
+void FillOrKillHonoursSelfTradePrevention(){
+    auto seed = [](Orderbook& book){
+        CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 5, 1, 6)).has_value());
+        CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 10, 2, 5)).has_value());
+        CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 101, 20, 3, 6)).has_value());
+    };
+
+    for (SelfTradePrevention stp : { SelfTradePrevention::CancelNewest, SelfTradePrevention::CancelBoth }){
+        Timestamp now = 0;
+        Orderbook book([&now]{ return now; });
+        seed(book);
+        auto before = Levels(book);
+        std::uint64_t checksum = book.Checksum();
+
+        auto trades = book.AddOrder(MakeOrder(OrderType::FillOrKill, Side::Buy, 101, 10, 4, 5, stp));
+        CHECK(trades.has_value() && trades->empty());
+        CHECK(book.GetTradeCount() == 0);
+        CHECK(book.Size() == 3);
+        CHECK(Levels(book) == before);
+        CHECK(book.Checksum() == checksum);
+    }
+
+    // cancel-oldest: the own order at 100 is cancelled and the rest comes from 101.
+    {
+        Timestamp now = 0;
+        Orderbook book([&now]{ return now; });
+        seed(book);
+        auto trades = book.AddOrder(MakeOrder(OrderType::FillOrKill, Side::Buy, 101, 10, 4, 5, SelfTradePrevention::CancelOldest));
+        CHECK(trades.has_value() && trades->size() == 2);
+        CHECK(book.Size() == 1);
+        CHECK(Levels(book) == (std::vector<std::tuple<Side, Price, Quantity>>{ { Side::Sell, 101, 15 } }));
+
+        // without 101 it would have to trade into its own order, so it is killed.
+        Orderbook shallow([&now]{ return now; });
+        CHECK(shallow.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 5, 1, 6)).has_value());
+        CHECK(shallow.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 10, 2, 5)).has_value());
+        trades = shallow.AddOrder(MakeOrder(OrderType::FillOrKill, Side::Buy, 100, 10, 4, 5, SelfTradePrevention::CancelOldest));
+        CHECK(trades.has_value() && trades->empty());
+        CHECK(shallow.Size() == 2);
+    }
+
+    // decrement: 5 trades, the other 5 is taken off both orders without a print, and 101 is never reached.
+    {
+        Timestamp now = 0;
+        Orderbook book([&now]{ return now; });
+        seed(book);
+        auto trades = book.AddOrder(MakeOrder(OrderType::FillOrKill, Side::Buy, 101, 10, 4, 5, SelfTradePrevention::Decrement));
+        CHECK(trades.has_value() && trades->size() == 1);
+        CHECK(Levels(book) == (std::vector<std::tuple<Side, Price, Quantity>>{ { Side::Sell, 100, 5 }, { Side::Sell, 101, 20 } }));
+    }
+
+    // another account's liquidity still fills it.
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 10, 1, 6)).has_value());
+    auto trades = book.AddOrder(MakeOrder(OrderType::FillOrKill, Side::Buy, 100, 10, 2, 5));
+    CHECK(trades.has_value() && trades->size() == 1);
+    CHECK(book.Size() == 0);
+}
+
+// a modify is risk checked as the order it would put back on the book, without the order it replaces, and a refused
+// modify leaves that order resting where it was.
+void ModifyIsRiskCheckedBeforeTheOrderMoves(){
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    RiskLimits limits;
+    limits.maxOpenOrders_ = 1;
+    limits.maxPosition_ = 10;
+    book.SetRiskLimits(limits);
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 10, 1, 5)).has_value());
+    auto before = Levels(book);
+
+    // a new order from the account would break the open order limit, moving its one order doesn't.
+    CHECK(book.CheckRisk(*MakeOrder(OrderType::GoodTillCancel, Side::Buy, 99, 5, 2, 5)) == RiskReject::OpenOrders);
+    CHECK(book.CheckRisk(OrderModify{ 1, Side::Buy, 99, 10 }) == RiskReject::None);
+    CHECK(book.CheckRisk(OrderModify{ 1, Side::Buy, 100, 4 }) == RiskReject::None);
+
+    // more quantity than the position limit allows.
+    OrderModify bigger{ 1, Side::Buy, 99, 11 };
+    CHECK(book.CheckRisk(bigger) == RiskReject::Position);
+    CHECK(Levels(book) == before);
+    CHECK(book.GetAccountRisk(5).openOrders_ == 1);
+    CHECK(book.GetAccountRisk(5).openBuyQuantity_ == 10);
+}
+
+// both legs of a quote are risk checked, without the live legs they replace, and one failing leg refuses the quote.
+void QuoteLegsAreRiskChecked(){
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    RiskLimits limits;
+    limits.maxOpenOrders_ = 3;
+    limits.maxExposure_ = 2000;
+    book.SetRiskLimits(limits);
+    Quote quote{ 5, SelfTradePrevention::CancelNewest, QuoteSide{ 1, 99, 10 }, QuoteSide{ 2, 101, 9 } };
+    CHECK(book.CheckRisk(quote) == RiskReject::None);
+    CHECK(book.UpdateQuote(quote).has_value());
+
+    // requoting replaces both live legs, so it doesn't count against the open order limit.
+    quote.bid_.price_ = 98;
+    CHECK(book.CheckRisk(quote) == RiskReject::None);
+
+    // the ask alone is within the exposure limit, but not on top of the bid.
+    quote.ask_.quantity_ = 11;
+    CHECK(book.CheckRisk(quote) == RiskReject::Exposure);
+    quote.bid_.quantity_ = 0;
+    CHECK(book.CheckRisk(quote) == RiskReject::None);
+
+    // once the ask leg has gone, quoting it again is a new open order: with two other orders resting that is one too many.
+    Quote both{ 5, SelfTradePrevention::CancelNewest, QuoteSide{ 1, 99, 10 }, QuoteSide{ 2, 101, 9 } };
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 90, 1, 3, 5)).has_value());
+    CHECK(book.CheckRisk(both) == RiskReject::None);
+    CHECK(book.CancelOrder(2).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 90, 1, 4, 5)).has_value());
+    CHECK(book.CheckRisk(both) == RiskReject::OpenOrders);
+}
+
+// orders refused on arrival report "rejected", not "cancelled" like an order that was cancelled after it was accepted.
+void OrdersRefusedOnArrivalAreRejected(){
+    Timestamp now = 1000;
+    Orderbook book([&now]{ return now; });
+    auto expired = MakeOrder(OrderType::GoodTillTime, Side::Buy, 100, 10, 1);
+    expired->SetExpiry(now);
+    CHECK(!book.AddOrder(expired).has_value());
+
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 10, 2)).has_value());
+    book.OpenAuction();
+    for (OrderType type : { OrderType::Market, OrderType::FillAndKill, OrderType::FillOrKill }){
+        CHECK(!book.AddOrder(MakeOrder(type, Side::Buy, 100, 10, 3)).has_value());
+        auto status = book.GetOrderStatus(3);
+        CHECK(status.has_value() && status->state_ == OrderState::Rejected);
+    }
+    CHECK(book.UncrossAuction().has_value());
+    CHECK(book.CancelOrder(2).has_value());
+
+    auto status = book.GetOrderStatus(1);
+    CHECK(status.has_value() && status->state_ == OrderState::Rejected && status->filled_ == 0);
+    status = book.GetOrderStatus(2);
+    CHECK(status.has_value() && status->state_ == OrderState::Cancelled);
+}
+
+// a market order walks the opposite side level by level with no limit, trading at each resting order's price, and
+// whatever it can't fill is dropped rather than left resting.
+void MarketOrderSweepsWithoutALimit(){
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 5, 1)).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 101, 5, 2)).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 105, 5, 3)).has_value());
+
+    auto order = MakeOrder(OrderType::Market, Side::Buy, 0, 12, 4);
+    auto trades = book.AddOrder(order);
+    CHECK(trades.has_value() && trades->size() == 3);
+    if (trades && trades->size() == 3){
+        CHECK((*trades)[0].GetAskTrade().price_ == 100 && (*trades)[0].GetAskTrade().quantity_ == 5);
+        CHECK((*trades)[1].GetAskTrade().price_ == 101 && (*trades)[1].GetAskTrade().quantity_ == 5);
+        CHECK((*trades)[2].GetAskTrade().price_ == 105 && (*trades)[2].GetAskTrade().quantity_ == 2);
+    }
+    CHECK(order->IsFilled());
+    CHECK(Levels(book) == (std::vector<std::tuple<Side, Price, Quantity>>{ { Side::Sell, 105, 3 } }));
+
+    // more than the book holds: it takes everything and the rest goes, nothing is left on the bid side.
+    auto large = MakeOrder(OrderType::Market, Side::Buy, 0, 10, 5);
+    trades = book.AddOrder(large);
+    CHECK(trades.has_value() && trades->size() == 1);
+    CHECK(large->FilledQuantity() == 3);
+    CHECK(book.Size() == 0);
+    CHECK(Levels(book).empty());
+
+    // and into an empty side it does nothing at all.
+    trades = book.AddOrder(MakeOrder(OrderType::Market, Side::Sell, 0, 10, 6));
+    CHECK(trades.has_value() && trades->empty());
+    CHECK(book.Size() == 0);
+    auto status = book.GetOrderStatus(6);
+    CHECK(status.has_value() && status->state_ == OrderState::Cancelled && status->filled_ == 0);
+}
+
+// a fill-or-kill fills completely across as many levels as its limit allows, counting iceberg reserve, or leaves the
+// book exactly as it found it.
+void FillOrKillFillsCompletelyOrNotAtAll(){
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 5, 1)).has_value());
+    auto iceberg = MakeOrder(OrderType::GoodTillCancel, Side::Sell, 101, 20, 2);
+    iceberg->SetDisplayQuantity(5);
+    CHECK(book.AddOrder(iceberg).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 103, 50, 3)).has_value());
+    auto before = Levels(book);
+    std::uint64_t checksum = book.Checksum();
+
+    // 25 is there up to 101 (most of it hidden), 26 isn't. 103 is past the limit.
+    auto killed = MakeOrder(OrderType::FillOrKill, Side::Buy, 101, 26, 4);
+    auto trades = book.AddOrder(killed);
+    CHECK(trades.has_value() && trades->empty());
+    CHECK(killed->FilledQuantity() == 0);
+    CHECK(Levels(book) == before);
+    CHECK(book.Checksum() == checksum);
+    auto status = book.GetOrderStatus(4);
+    CHECK(status.has_value() && status->state_ == OrderState::Cancelled);
+
+    auto filled = MakeOrder(OrderType::FillOrKill, Side::Buy, 101, 25, 5);
+    trades = book.AddOrder(filled);
+    CHECK(trades.has_value());
+    CHECK(filled->IsFilled());
+    CHECK(Levels(book) == (std::vector<std::tuple<Side, Price, Quantity>>{ { Side::Sell, 103, 50 } }));
+}
+
+// GTT orders come off the book together as soon as the injected clock reaches their expiry, and before anything else
+// the book does at that time can trade with them. GFD orders go at the session close.
+void GoodTillTimeOrdersExpireInOneBatch(){
+    constexpr Timestamp Day = 24 * 60 * 60 * 1000;
+    Timestamp now = 100 * Day + 9 * 60 * 60 * 1000; // 09:00 UTC
+    Orderbook book([&now]{ return now; });
+    for (OrderId id : { 1, 2 }){
+        auto order = MakeOrder(OrderType::GoodTillTime, Side::Buy, 100, 10, id);
+        order->SetExpiry(now + 250);
+        CHECK(book.AddOrder(order).has_value());
+    }
+    auto later = MakeOrder(OrderType::GoodTillTime, Side::Buy, 99, 10, 3);
+    later->SetExpiry(now + 60'000);
+    CHECK(book.AddOrder(later).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodForDay, Side::Buy, 98, 10, 4)).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 97, 10, 5)).has_value());
+    CHECK(book.ArmedExpiries() == 4);
+
+    now += 249;
+    book.ExpireOrders();
+    CHECK(book.Size() == 5);
+
+    // the sell arrives at the expiry time: both GTTs at 100 are gone first, so it trades with the one at 99.
+    now += 1;
+    auto trades = book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 99, 10, 6));
+    CHECK(trades.has_value() && trades->size() == 1);
+    if (trades && trades->size() == 1){
+        CHECK((*trades)[0].GetBidTrade().orderid_ == 3);
+    }
+    for (OrderId id : { 1, 2 }){
+        auto status = book.GetOrderStatus(id);
+        CHECK(status.has_value() && status->state_ == OrderState::Cancelled && status->filled_ == 0);
+    }
+    CHECK(book.ArmedExpiries() == 1);
+
+    // 16:00 UTC closes the session.
+    now = 100 * Day + 16 * 60 * 60 * 1000 - 1;
+    book.ExpireOrders();
+    CHECK(book.Size() == 2);
+    now += 1;
+    book.ExpireOrders();
+    CHECK(book.ArmedExpiries() == 0);
+    CHECK(Levels(book) == (std::vector<std::tuple<Side, Price, Quantity>>{ { Side::Buy, 97, 10 } }));
+}
+
+// a trade that triggers stops runs them one at a time, best stop price first and in arrival order within a price,
+// and any stop a triggered one sets off joins the back of the same queue. the same inputs always give the same tape.
+void StopCascadeRunsInStopPriceThenArrivalOrder(){
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    OrderId id = 1;
+    for (Price price : { 100, 99, 98, 97 }){
+        CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, price, 10, id++)).has_value());
+    }
+    auto stop = [&book](OrderId orderId, Price stopPrice){
+        auto order = MakeOrder(OrderType::Stop, Side::Sell, 0, 10, orderId);
+        order->SetStopPrice(stopPrice);
+        CHECK(book.AddOrder(order).has_value());
+    };
+    stop(10, 99);
+    stop(11, 100);
+    stop(12, 100);
+    stop(13, 90);
+    CHECK(book.GetOrderStatus(11).has_value() && book.GetOrderStatus(11)->state_ == OrderState::Pending);
+
+    // trading at 100 sets off 11 and 12. 11 takes the bid at 99, which sets off 10 behind 12.
+    auto trades = book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 10, 20));
+    CHECK(trades.has_value() && trades->size() == 4);
+    std::vector<std::tuple<OrderId, OrderId, Price>> executions;
+    for (Trade& trade : trades.value_or(Trades{ })){
+        executions.emplace_back(trade.GetAskTrade().orderid_, trade.GetBidTrade().orderid_, trade.GetAskTrade().price_);
+    }
+    CHECK(executions == (std::vector<std::tuple<OrderId, OrderId, Price>>{ { 20, 1, 100 }, { 11, 2, 99 }, { 12, 3, 98 }, { 10, 4, 97 } }));
+
+    // the tape has them in the same order.
+    auto tape = book.GetTrades(0, 10);
+    CHECK(tape.size() == 4);
+    if (tape.size() == 4){
+        CHECK(tape[1].sellOrderId_ == 11 && tape[2].sellOrderId_ == 12 && tape[3].sellOrderId_ == 10);
+    }
+    CHECK(book.GetOrderStatus(13).has_value() && book.GetOrderStatus(13)->state_ == OrderState::Pending);
+    CHECK(book.Size() == 1);
+}
+
+// once an iceberg's displayed slice trades away it shows the next one from its reserve, and that slice waits behind
+// everything already at the level. only the displayed slice is ever in the level's quantity.
+void IcebergRefillsAtTheBackOfTheQueue(){
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    auto iceberg = MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 30, 1);
+    iceberg->SetDisplayQuantity(10);
+    CHECK(book.AddOrder(iceberg).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 10, 2)).has_value());
+    CHECK(Levels(book) == (std::vector<std::tuple<Side, Price, Quantity>>{ { Side::Sell, 100, 20 } }));
+
+    auto trades = book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 10, 3));
+    CHECK(trades.has_value() && trades->size() == 1 && (*trades)[0].GetAskTrade().orderid_ == 1);
+    CHECK(Levels(book) == (std::vector<std::tuple<Side, Price, Quantity>>{ { Side::Sell, 100, 20 } }));
+    auto status = book.GetOrderStatus(1);
+    CHECK(status.has_value() && status->ordersAhead_ == 1 && status->quantityAhead_ == 10);
+    CHECK(status.has_value() && status->filled_ == 10 && status->remaining_ == 20);
+
+    // so the next buyer meets order 2 first.
+    trades = book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 10, 4));
+    CHECK(trades.has_value() && trades->size() == 1 && (*trades)[0].GetAskTrade().orderid_ == 2);
+
+    // alone at the level, the iceberg refills straight into the same sweep.
+    trades = book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 15, 5));
+    CHECK(trades.has_value() && trades->size() == 2);
+    CHECK(Levels(book) == (std::vector<std::tuple<Side, Price, Quantity>>{ { Side::Sell, 100, 5 } }));
+    status = book.GetOrderStatus(1);
+    CHECK(status.has_value() && status->state_ == OrderState::PartiallyFilled && status->remaining_ == 5);
+}
+
+// when a resting order turns out to be the aggressor's own, the aggressor's self-trade prevention mode decides what
+// happens to each of them. trades before that point stand, and anonymous orders are never checked.
+void SelfTradePreventionModesInTheMatchLoop(){
+    using LevelList = std::vector<std::tuple<Side, Price, Quantity>>;
+    struct Case{
+        SelfTradePrevention stp_;
+        std::size_t trades_;
+        LevelList levels_;
+        std::uint32_t ownResting_; // account 5's orders left on the book
+    };
+    const std::vector<Case> cases{
+        // the aggressor goes, with 7 unfilled.
+        { SelfTradePrevention::CancelNewest, 1, { { Side::Sell, 100, 10 }, { Side::Sell, 101, 10 } }, 1 },
+        // the resting one goes and the aggressor carries on to 101.
+        { SelfTradePrevention::CancelOldest, 2, { { Side::Sell, 101, 3 } }, 0 },
+        { SelfTradePrevention::CancelBoth, 1, { { Side::Sell, 101, 10 } }, 0 },
+        // 7 comes off both without a print.
+        { SelfTradePrevention::Decrement, 1, { { Side::Sell, 100, 3 }, { Side::Sell, 101, 10 } }, 1 },
+    };
+    for (const Case& test : cases){
+        Timestamp now = 0;
+        Orderbook book([&now]{ return now; });
+        CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 5, 1, 6)).has_value());
+        CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 10, 2, 5)).has_value());
+        CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 101, 10, 3, 6)).has_value());
+
+        auto trades = book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 101, 12, 4, 5, test.stp_));
+        CHECK(trades.has_value() && trades->size() == test.trades_);
+        CHECK(Levels(book) == test.levels_);
+        CHECK(book.GetAccountRisk(5).openOrders_ == test.ownResting_);
+    }
+
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 5, 1)).has_value());
+    auto trades = book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 5, 2));
+    CHECK(trades.has_value() && trades->size() == 1);
+}
+
+// the uncross price is the one that executes the most, and everything that crosses it trades there. the ladder
+// below peaks at 101, where 60 is bid at or above and 60 offered at or below.
+void AuctionUncrossesAtTheEquilibriumPrice(){
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    book.OpenAuction();
+    const std::vector<std::tuple<Side, Price, Quantity>> ladder{
+        { Side::Buy, 103, 10 }, { Side::Buy, 102, 20 }, { Side::Buy, 101, 30 }, { Side::Buy, 100, 40 },
+        { Side::Sell, 99, 25 }, { Side::Sell, 100, 15 }, { Side::Sell, 101, 20 }, { Side::Sell, 102, 30 },
+    };
+    OrderId id = 1;
+    for (const auto& [side, price, quantity] : ladder){
+        CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, side, price, quantity, id++)).has_value());
+    }
+    CHECK(book.GetTradeCount() == 0);
+
+    // brute force: the volume at every price on the ladder.
+    Price bestPrice = 0;
+    std::uint64_t bestVolume = 0;
+    for (const auto& [_, candidate, __] : ladder){
+        std::uint64_t demand = 0, supply = 0;
+        for (const auto& [side, price, quantity] : ladder){
+            demand += side == Side::Buy && price >= candidate ? quantity : 0;
+            supply += side == Side::Sell && price <= candidate ? quantity : 0;
+        }
+        if (std::min(demand, supply) > bestVolume){
+            bestVolume = std::min(demand, supply);
+            bestPrice = candidate;
+        }
+    }
+    CHECK(bestPrice == 101 && bestVolume == 60);
+
+    AuctionIndicative indicative = book.GetAuctionIndicative();
+    CHECK(indicative.price_ == bestPrice);
+    CHECK(indicative.volume_ == bestVolume);
+    CHECK(indicative.imbalance_ == 0);
+
+    auto trades = book.UncrossAuction();
+    CHECK(trades.has_value());
+    std::uint64_t volume = 0;
+    for (const TapeTrade& trade : book.GetTrades(0, 100)){
+        CHECK(trade.price_ == 101 && trade.auction_);
+        volume += trade.quantity_;
+    }
+    CHECK(volume == 60);
+    CHECK(book.GetPhase() == TradingPhase::Continuous);
+    CHECK(Levels(book) == (std::vector<std::tuple<Side, Price, Quantity>>{ { Side::Buy, 100, 40 }, { Side::Sell, 102, 30 } }));
+    CHECK(!book.GetAuctionIndicative().price_);
+}
+
+// each limit refuses the order that would break it, from counters the book keeps as orders rest, fill and cancel.
+void RiskLimitsComeFromTheAccountCounters(){
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    RiskLimits limits;
+    limits.maxOrderQuantity_ = 100;
+    limits.maxOrderNotional_ = 5000;
+    limits.maxOpenOrders_ = 2;
+    limits.maxPosition_ = 50;
+    limits.maxExposure_ = 5000;
+    book.SetRiskLimits(limits);
+    auto check = [&book](Side side, Price price, Quantity quantity, AccountId owner){
+        return book.CheckRisk(*MakeOrder(OrderType::GoodTillCancel, side, price, quantity, 100, owner));
+    };
+
+    CHECK(check(Side::Buy, 10, 101, 5) == RiskReject::OrderQuantity);
+    CHECK(check(Side::Buy, 100, 51, 5) == RiskReject::OrderNotional);
+
+    CHECK(check(Side::Buy, 100, 30, 5) == RiskReject::None);
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 30, 1, 5)).has_value());
+    // 30 resting plus 30 more could leave the account 60 long.
+    CHECK(check(Side::Buy, 90, 30, 5) == RiskReject::Position);
+    CHECK(check(Side::Buy, 99, 20, 5) == RiskReject::None);
+    CHECK(check(Side::Sell, 110, 20, 5) == RiskReject::Exposure);
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 90, 20, 2, 5)).has_value());
+    CHECK(check(Side::Sell, 1, 1, 5) == RiskReject::OpenOrders);
+
+    // anonymous orders only have the per-order limits.
+    CHECK(check(Side::Buy, 100, 50, 0) == RiskReject::None);
+
+    // a fill moves the 30 from open to position, a cancel frees an order and its exposure.
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 30, 3, 6)).has_value());
+    AccountRisk account = book.GetAccountRisk(5);
+    CHECK(account.position_ == 30 && account.openBuyQuantity_ == 20 && account.openOrders_ == 1 && account.openNotional_ == 1800);
+    CHECK(book.GetAccountRisk(6).position_ == -30);
+    CHECK(check(Side::Buy, 10, 1, 5) == RiskReject::Position);
+    CHECK(book.CancelOrder(2).has_value());
+    account = book.GetAccountRisk(5);
+    CHECK(account.openOrders_ == 0 && account.openBuyQuantity_ == 0 && account.openNotional_ == 0 && account.position_ == 30);
+    CHECK(check(Side::Buy, 10, 20, 5) == RiskReject::None);
+    CHECK(check(Side::Buy, 10, 21, 5) == RiskReject::Position);
+    CHECK(check(Side::Sell, 10, 80, 5) == RiskReject::None);
+}
+
+// the two sides are the same code compiled twice, so a flow and its mirror image (sides swapped, prices reflected
+// around 1000) have to trade the same quantities and leave mirror-image books.
+void MirroredFlowsTradeTheSame(){
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    Orderbook mirror([&now]{ return now; });
+    auto flip = [](Side side){ return side == Side::Buy ? Side::Sell : Side::Buy; };
+    constexpr Price Center = 1000;
+
+    std::uint64_t state = 12345;
+    auto next = [&state](std::uint64_t bound){
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return (state >> 33) % bound;
+    };
+    const OrderType types[]{ OrderType::GoodTillCancel, OrderType::GoodTillCancel, OrderType::FillAndKill,
+        OrderType::FillOrKill, OrderType::Market };
+    for (OrderId id = 1; id <= 2000; id++){
+        if (next(4) == 0){
+            OrderId victim = 1 + next(id);
+            CHECK(book.CancelOrder(victim).has_value() == mirror.CancelOrder(victim).has_value());
+            continue;
+        }
+        OrderType type = types[next(5)];
+        Side side = next(2) ? Side::Buy : Side::Sell;
+        Price price = static_cast<Price>(Center - 10 + next(21));
+        Quantity quantity = static_cast<Quantity>(1 + next(50));
+        auto order = MakeOrder(type, side, price, quantity, id);
+        auto reflected = MakeOrder(type, flip(side), 2 * Center - price, quantity, id);
+        auto trades = book.AddOrder(order);
+        auto reflectedTrades = mirror.AddOrder(reflected);
+        CHECK(trades.has_value() && reflectedTrades.has_value() && trades->size() == reflectedTrades->size());
+        CHECK(order->FilledQuantity() == reflected->FilledQuantity());
+    }
+
+    std::vector<std::tuple<Side, Price, Quantity>> reflectedLevels;
+    for (const auto& [side, price, quantity] : Levels(mirror)){
+        reflectedLevels.emplace_back(flip(side), 2 * Center - price, quantity);
+    }
+    std::sort(reflectedLevels.begin(), reflectedLevels.end());
+    auto levels = Levels(book);
+    std::sort(levels.begin(), levels.end());
+    CHECK(levels == reflectedLevels);
+    CHECK(book.GetTradeCount() != 0 && book.GetTradeCount() == mirror.GetTradeCount());
+}
+
+// orders live in pooled slots that are reused as soon as an order leaves, with the level FIFO threaded through them.
+// a long flow of adds, fills and cancels has to leave the same book as a plain price-time reference model, trade for
+// trade, however often the slots have been recycled.
+void PooledOrdersMatchAReferenceModel(){
+    struct Resting{
+        OrderId id_;
+        Side side_;
+        Price price_;
+        Quantity quantity_;
+    };
+    std::vector<Resting> model; // arrival order
+    auto modelAdd = [&model](Resting incoming){
+        std::vector<std::pair<OrderId, Quantity>> fills;
+        while (incoming.quantity_ != 0){
+            // best opposite price, earliest arrival first.
+            auto best = model.end();
+            for (auto resting = model.begin(); resting != model.end(); ++resting){
+                bool crosses = incoming.side_ == Side::Buy ? resting->price_ <= incoming.price_ : resting->price_ >= incoming.price_;
+                if (resting->side_ == incoming.side_ || !crosses){
+                    continue;
+                }
+                bool better = best == model.end()
+                    || (incoming.side_ == Side::Buy ? resting->price_ < best->price_ : resting->price_ > best->price_);
+                best = better ? resting : best;
+            }
+            if (best == model.end()){
+                break;
+            }
+            Quantity quantity = std::min(incoming.quantity_, best->quantity_);
+            fills.emplace_back(best->id_, quantity);
+            incoming.quantity_ -= quantity;
+            best->quantity_ -= quantity;
+            if (best->quantity_ == 0){
+                model.erase(best);
+            }
+        }
+        if (incoming.quantity_ != 0){
+            model.push_back(incoming);
+        }
+        return fills;
+    };
+
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    std::uint64_t state = 99;
+    auto next = [&state](std::uint64_t bound){
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return (state >> 33) % bound;
+    };
+    for (OrderId id = 1; id <= 3000; id++){
+        if (next(3) == 0 && !model.empty()){
+            auto victim = model.begin() + static_cast<std::ptrdiff_t>(next(model.size()));
+            CHECK(book.CancelOrder(victim->id_).has_value());
+            model.erase(victim);
+            continue;
+        }
+        Resting incoming{ id, next(2) ? Side::Buy : Side::Sell, static_cast<Price>(95 + next(11)), static_cast<Quantity>(1 + next(20)) };
+        auto fills = modelAdd(incoming);
+        auto trades = book.AddOrder(MakeOrder(OrderType::GoodTillCancel, incoming.side_, incoming.price_, incoming.quantity_, id));
+        CHECK(trades.has_value() && trades->size() == fills.size());
+        for (std::size_t i = 0; trades && i < std::min(trades->size(), fills.size()); i++){
+            Trade& trade = (*trades)[i];
+            const TradeInfo& resting = incoming.side_ == Side::Buy ? trade.GetAskTrade() : trade.GetBidTrade();
+            CHECK(resting.orderid_ == fills[i].first && resting.quantity_ == fills[i].second);
+        }
+    }
+    CHECK(book.Size() == model.size());
+    for (const Resting& resting : model){
+        auto status = book.GetOrderStatus(resting.id_);
+        CHECK(status.has_value() && status->remaining_ == resting.quantity_ && status->price_ == resting.price_);
+    }
+}
+
+// every refusal comes back as an OrderError in the Result (the engine is built without exceptions) and changes nothing.
+void RefusalsComeBackAsErrors(){
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 10, 1)).has_value());
+    auto before = Levels(book);
+    std::uint64_t checksum = book.Checksum();
+
+    auto duplicate = book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 10, 1));
+    CHECK(!duplicate.has_value() && duplicate.error() == OrderError::DuplicateOrderId);
+    auto cancel = book.CancelOrder(2);
+    CHECK(!cancel.has_value() && cancel.error() == OrderError::UnknownOrder);
+    auto modify = book.MatchOrder(OrderModify{ 2, Side::Buy, 100, 5 });
+    CHECK(!modify.has_value() && modify.error() == OrderError::UnknownOrder);
+    auto uncross = book.UncrossAuction();
+    CHECK(!uncross.has_value() && uncross.error() == OrderError::NotInAuction);
+    auto anonymous = book.UpdateQuote(Quote{ 0, SelfTradePrevention::CancelNewest, QuoteSide{ 3, 99, 10 }, QuoteSide{ 4, 101, 10 } });
+    CHECK(!anonymous.has_value() && anonymous.error() == OrderError::QuoteWithoutAccount);
+    auto crossed = book.UpdateQuote(Quote{ 5, SelfTradePrevention::CancelNewest, QuoteSide{ 3, 101, 10 }, QuoteSide{ 4, 101, 10 } });
+    CHECK(!crossed.has_value() && crossed.error() == OrderError::CrossedQuote);
+    auto status = book.GetOrderStatus(2);
+    CHECK(!status.has_value() && status.error() == OrderError::UnknownOrder);
+
+    CHECK(Levels(book) == before);
+    CHECK(book.Checksum() == checksum);
+    CHECK(book.Size() == 1);
+    CHECK(std::string(OrderErrorName(OrderError::DuplicateOrderId)) == "order id already in use");
+}
+
+// cutting an order's quantity at the same price keeps its place in the queue. more quantity, or a new price, sends it
+// to the back as if it had just arrived, and a modify that crosses trades straight away.
+void ModifyKeepsPriorityOnlyForACut(){
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 10, 1)).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 10, 2)).has_value());
+    auto ahead = [&book](OrderId id){
+        auto status = book.GetOrderStatus(id);
+        return status ? status->ordersAhead_ : std::uint64_t{ 99 };
+    };
+
+    auto trades = book.MatchOrder(OrderModify{ 1, Side::Buy, 100, 4 });
+    CHECK(trades.has_value() && trades->empty());
+    CHECK(ahead(1) == 0 && ahead(2) == 1);
+    CHECK(Levels(book) == (std::vector<std::tuple<Side, Price, Quantity>>{ { Side::Buy, 100, 14 } }));
+    auto status = book.GetOrderStatus(1);
+    CHECK(status.has_value() && status->initial_ == 4 && status->filled_ == 0);
+
+    CHECK(book.MatchOrder(OrderModify{ 1, Side::Buy, 100, 6 }).has_value());
+    CHECK(ahead(1) == 1 && ahead(2) == 0);
+
+    // a sell arrives at 100: order 2 is now first.
+    trades = book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 3, 3));
+    CHECK(trades.has_value() && trades->size() == 1 && (*trades)[0].GetBidTrade().orderid_ == 2);
+
+    // moving order 1 up to an offer trades against it, and the rest rests at the new price.
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 102, 2, 4)).has_value());
+    trades = book.MatchOrder(OrderModify{ 1, Side::Buy, 102, 6 });
+    CHECK(trades.has_value() && trades->size() == 1 && (*trades)[0].GetBidTrade().quantity_ == 2);
+    CHECK(Levels(book) == (std::vector<std::tuple<Side, Price, Quantity>>{ { Side::Buy, 102, 4 }, { Side::Buy, 100, 7 } }));
+}
+
+// a requote updates the account's live legs in place: a leg that only shrinks keeps its queue priority, a quantity of 0
+// pulls that side, and a leg that crosses trades in the same update.
+void RequoteUpdatesTheLiveLegs(){
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    auto ack = book.UpdateQuote(Quote{ 5, SelfTradePrevention::CancelNewest, QuoteSide{ 1, 99, 10 }, QuoteSide{ 2, 101, 10 } });
+    CHECK(ack.has_value() && ack->bidId_ == 1 && ack->askId_ == 2 && ack->trades_.empty());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 99, 10, 3)).has_value());
+
+    // the ids in a requote are only for legs the account doesn't have yet.
+    ack = book.UpdateQuote(Quote{ 5, SelfTradePrevention::CancelNewest, QuoteSide{ 7, 99, 6 }, QuoteSide{ 8, 101, 0 } });
+    CHECK(ack.has_value() && ack->bidId_ == 1 && ack->askId_ == 0);
+    auto status = book.GetOrderStatus(1);
+    CHECK(status.has_value() && status->ordersAhead_ == 0 && status->remaining_ == 6);
+    CHECK(Levels(book) == (std::vector<std::tuple<Side, Price, Quantity>>{ { Side::Buy, 99, 16 } }));
+    CHECK(book.GetAccountRisk(5).openOrders_ == 1);
+
+    // the ask comes back under the new id, and the bid grows, which costs it its place.
+    ack = book.UpdateQuote(Quote{ 5, SelfTradePrevention::CancelNewest, QuoteSide{ 7, 99, 8 }, QuoteSide{ 8, 102, 5 } });
+    CHECK(ack.has_value() && ack->bidId_ == 1 && ack->askId_ == 8);
+    status = book.GetOrderStatus(1);
+    CHECK(status.has_value() && status->ordersAhead_ == 1);
+
+    // an offer comes in at 100, and lifting the bid to it trades.
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 3, 9)).has_value());
+    ack = book.UpdateQuote(Quote{ 5, SelfTradePrevention::CancelNewest, QuoteSide{ 7, 100, 8 }, QuoteSide{ 8, 102, 5 } });
+    CHECK(ack.has_value() && ack->trades_.size() == 1 && ack->trades_[0].GetBidTrade().orderid_ == 1);
+    CHECK(Levels(book) == (std::vector<std::tuple<Side, Price, Quantity>>{ { Side::Buy, 100, 5 }, { Side::Buy, 99, 10 }, { Side::Sell, 102, 5 } }));
+}
+
+// a mass cancel removes exactly the orders every set filter matches (parked stops included), returns how many went and
+// keeps the account counters in step. an empty filter empties the book.
+void MassCancelMatchesEveryFilter(){
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 98, 10, 1, 5)).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 99, 10, 2, 6)).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 10, 3, 5)).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 101, 10, 4, 5)).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 102, 10, 5, 6)).has_value());
+    auto stop = MakeOrder(OrderType::Stop, Side::Sell, 0, 10, 6, 5);
+    stop->SetStopPrice(90);
+    CHECK(book.AddOrder(stop).has_value());
+
+    CHECK(book.CancelOrders(MassCancelFilter{ .side_ = Side::Buy, .minPrice_ = 99, .owner_ = 5 }) == 1);
+    CHECK(!book.GetOrderStatus(3) || book.GetOrderStatus(3)->state_ == OrderState::Cancelled);
+    CHECK(book.CancelOrders(MassCancelFilter{ .minPrice_ = 100, .maxPrice_ = 99 }) == 0);
+
+    CHECK(book.CancelOrders(MassCancelFilter{ .owner_ = 5, .includeStops_ = false }) == 2);
+    CHECK(book.GetOrderStatus(6).has_value() && book.GetOrderStatus(6)->state_ == OrderState::Pending);
+    CHECK(book.CancelOrders(MassCancelFilter{ .owner_ = 5 }) == 1);
+    CHECK(book.GetAccountRisk(5).openOrders_ == 0 && book.GetAccountRisk(5).openNotional_ == 0);
+    CHECK(Levels(book) == (std::vector<std::tuple<Side, Price, Quantity>>{ { Side::Buy, 99, 10 }, { Side::Sell, 102, 10 } }));
+
+    CHECK(book.CancelOrders(MassCancelFilter{ .side_ = Side::Sell, .minPrice_ = 100, .maxPrice_ = 102 }) == 1);
+    CHECK(book.CancelOrders() == 1);
+    CHECK(book.Size() == 0);
+    CHECK(Levels(book).empty());
+    CHECK(book.GetAccountRisk(6).openOrders_ == 0 && book.GetAccountRisk(6).openBuyQuantity_ == 0);
+}
+
+// the published top of book follows the touch and the last execution through adds, trades, cancels and modifies. only
+// displayed quantity shows, and a side with no orders (or no trade yet) reads as zeros.
+void TopOfBookFollowsTheTouch(){
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    CHECK(book.GetTopOfBook() == TopOfBook{ });
+
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 99, 10, 1)).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 99, 5, 2)).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 98, 20, 3)).has_value());
+    auto iceberg = MakeOrder(OrderType::GoodTillCancel, Side::Sell, 101, 50, 4);
+    iceberg->SetDisplayQuantity(5);
+    CHECK(book.AddOrder(iceberg).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 101, 7, 5)).has_value());
+    CHECK(book.GetTopOfBook() == (TopOfBook{ 99, 15, 101, 12, 0, 0 }));
+
+    // a refused command publishes nothing new.
+    CHECK(!book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 1, 1)).has_value());
+    CHECK(book.GetTopOfBook() == (TopOfBook{ 99, 15, 101, 12, 0, 0 }));
+
+    // the last trade is the last execution of the sweep: 10 from order 1, then 2 from order 2.
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 99, 12, 6)).has_value());
+    CHECK(book.GetTopOfBook() == (TopOfBook{ 99, 3, 101, 12, 99, 2 }));
+
+    CHECK(book.CancelOrder(2).has_value());
+    CHECK(book.GetTopOfBook() == (TopOfBook{ 98, 20, 101, 12, 99, 2 }));
+    CHECK(book.MatchOrder(OrderModify{ 5, Side::Sell, 100, 7 }).has_value());
+    CHECK(book.GetTopOfBook() == (TopOfBook{ 98, 20, 100, 7, 99, 2 }));
+
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 9, 7)).has_value());
+    CHECK(book.GetTopOfBook() == (TopOfBook{ 100, 2, 101, 5, 100, 7 }));
+    CHECK(book.CancelOrders() == 3);
+    CHECK(book.GetTopOfBook() == (TopOfBook{ 0, 0, 0, 0, 100, 7 }));
+}
+
+// the ladder's running totals give the same answers as walking the levels one by one, best first, over a book that
+// keeps changing: icebergs show only their displayed slice, and levels far past the ladder's window still count.
+void FillEstimatesMatchAWalkOfTheLevels(){
+    auto walk = [](const std::vector<std::tuple<Side, Price, Quantity>>& levels, Side side, Quantity quantity){
+        FillEstimate estimate;
+        for (const auto& [levelSide, price, available] : levels){
+            if (levelSide == side || estimate.quantity_ == quantity){
+                continue;
+            }
+            std::uint64_t take = std::min<std::uint64_t>(available, quantity - estimate.quantity_);
+            estimate.quantity_ += take;
+            estimate.notional_ += static_cast<std::int64_t>(take) * price;
+            estimate.worstPrice_ = price;
+        }
+        return estimate;
+    };
+    auto available = [](const std::vector<std::tuple<Side, Price, Quantity>>& levels, Side side, Price limit){
+        std::uint64_t total = 0;
+        for (const auto& [levelSide, price, quantity] : levels){
+            if (levelSide != side && (side == Side::Buy ? price <= limit : price >= limit)){
+                total += quantity;
+            }
+        }
+        return total;
+    };
+
+    constexpr Price Center = 200'000;
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    std::uint64_t state = 45;
+    auto next = [&state](std::uint64_t bound){
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return (state >> 33) % bound;
+    };
+    int compared = 0;
+    for (OrderId id = 1; id <= 4000; id++){
+        if (next(4) == 0){
+            book.CancelOrder(1 + next(id)); // often long gone, which is fine
+        }else{
+            Side side = next(2) ? Side::Buy : Side::Sell;
+            // mostly near the touch, now and then far enough out to be past the window, and sometimes crossing.
+            Price offset = next(10) == 0 ? static_cast<Price>(1 + next(150'000)) : static_cast<Price>(next(40)) - 5;
+            Price price = side == Side::Buy ? Center - offset : Center + offset;
+            auto order = MakeOrder(OrderType::GoodTillCancel, side, price, static_cast<Quantity>(1 + next(100)), id);
+            if (next(5) == 0){
+                order->SetDisplayQuantity(static_cast<Quantity>(1 + next(10)));
+            }
+            book.AddOrder(order);
+        }
+        if (id % 50 != 0){
+            continue;
+        }
+
+        auto levels = Levels(book);
+        for (Side side : { Side::Buy, Side::Sell }){
+            std::uint64_t total = walk(levels, side, std::numeric_limits<Quantity>::max()).quantity_;
+            for (Quantity quantity : { Quantity{ 1 }, Quantity{ 37 }, Quantity{ 500 }, Quantity{ 5000 }, static_cast<Quantity>(total),
+                    static_cast<Quantity>(total + 1) }){
+                FillEstimate expected = walk(levels, side, quantity);
+                FillEstimate estimate = book.EstimateFill(side, quantity);
+                CHECK(estimate.quantity_ == expected.quantity_ && estimate.notional_ == expected.notional_);
+                CHECK(estimate.worstPrice_ == expected.worstPrice_);
+                compared++;
+            }
+            for (const auto& [levelSide, price, _] : levels){
+                if (levelSide != side && next(4) == 0){
+                    Price before = side == Side::Buy ? price - 1 : price + 1; // just short of the level
+                    CHECK(book.QuantityAvailable(side, price) == available(levels, side, price));
+                    CHECK(book.QuantityAvailable(side, before) == available(levels, side, before));
+                }
+            }
+        }
+    }
+    CHECK(compared == 80 * 2 * 6);
+    CHECK(book.EstimateFill(Side::Buy, 0).quantity_ == 0 && !book.EstimateFill(Side::Buy, 0).worstPrice_);
+}
+
+// an order's queue position is what sits in front of it at its own level (displayed quantity only), and it moves up
+// as those orders cancel, fill or cut their size. orders that have left the book keep answering with how they left.
+void OrderStatusTracksTheQueueAhead(){
+    Timestamp now = 0;
+    Orderbook book([&now]{ return now; });
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 10, 1)).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 20, 2)).has_value());
+    auto iceberg = MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 60, 3);
+    iceberg->SetDisplayQuantity(5);
+    CHECK(book.AddOrder(iceberg).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 40, 4)).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 50, 5)).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 99, 10, 6)).has_value());
+    auto stop = MakeOrder(OrderType::Stop, Side::Buy, 0, 10, 7);
+    stop->SetStopPrice(150);
+    CHECK(book.AddOrder(stop).has_value());
+
+    using Position = std::pair<std::uint64_t, std::uint64_t>; // orders ahead, their quantity
+    auto ahead = [&book](OrderId id){
+        auto status = book.GetOrderStatus(id);
+        return status ? Position{ status->ordersAhead_, status->quantityAhead_ } : Position{ ~0ull, ~0ull };
+    };
+    CHECK(ahead(1) == (Position{ 0, 0 }));
+    CHECK(ahead(5) == (Position{ 4, 75 }));
+    CHECK(ahead(6) == (Position{ 0, 0 })); // first at its own level
+    auto pending = book.GetOrderStatus(7);
+    CHECK(pending.has_value() && pending->state_ == OrderState::Pending && pending->ordersAhead_ == 0);
+
+    CHECK(book.CancelOrder(2).has_value());
+    CHECK(ahead(5) == (Position{ 3, 55 }));
+
+    // 10 fills order 1, 5 takes the iceberg's slice, which refills behind order 5.
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 15, 8)).has_value());
+    CHECK(ahead(5) == (Position{ 1, 40 }));
+    CHECK(ahead(3) == (Position{ 2, 90 }));
+    auto iced = book.GetOrderStatus(3);
+    CHECK(iced.has_value() && iced->state_ == OrderState::PartiallyFilled && iced->filled_ == 5 && iced->remaining_ == 55);
+
+    // cutting an order ahead in place shrinks the queue without reordering it.
+    CHECK(book.MatchOrder(OrderModify{ 4, Side::Buy, 100, 15 }).has_value());
+    CHECK(ahead(5) == (Position{ 1, 15 }));
+
+    auto filled = book.GetOrderStatus(1);
+    CHECK(filled.has_value() && filled->state_ == OrderState::Filled && filled->filled_ == 10 && filled->remaining_ == 0);
+    auto cancelled = book.GetOrderStatus(2);
+    CHECK(cancelled.has_value() && cancelled->state_ == OrderState::Cancelled && cancelled->filled_ == 0);
+    CHECK(ahead(1) == (Position{ 0, 0 }));
+    auto unknown = book.GetOrderStatus(99);
+    CHECK(!unknown.has_value() && unknown.error() == OrderError::UnknownOrder);
+}
+
+// every execution goes on the tape with the next sequence and the book's clock at the time, so FindTrade() can
+// binary-search it. once the tape has gone round, it answers from the oldest trade it still holds.
+void TradeTapeKeepsSequenceAndTime(){
+    Timestamp now = 1000;
+    Orderbook book([&now]{ return now; });
+    CHECK(book.GetTradeCount() == 0 && book.GetTrades(0, 10).empty() && book.FindTrade(0) == 0);
+
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 5, 1)).has_value());
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 101, 5, 2)).has_value());
+    now = 1005;
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 101, 12, 3)).has_value());
+    now = 1010;
+    CHECK(book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 99, 2, 4)).has_value());
+    auto trades = book.GetTrades(0, 10);
+    CHECK(trades.size() == 3);
+    if (trades.size() == 3){
+        CHECK(trades[0].sequence_ == 0 && trades[0].timestamp_ == 1005 && trades[0].buyOrderId_ == 3 && trades[0].sellOrderId_ == 1);
+        CHECK(trades[0].price_ == 100 && trades[0].quantity_ == 5 && trades[0].aggressor_ == Side::Buy && !trades[0].auction_);
+        CHECK(trades[1].sequence_ == 1 && trades[1].timestamp_ == 1005 && trades[1].price_ == 101 && trades[1].quantity_ == 5);
+        CHECK(trades[2].sequence_ == 2 && trades[2].timestamp_ == 1010 && trades[2].buyOrderId_ == 3 && trades[2].sellOrderId_ == 4);
+        CHECK(trades[2].price_ == 101 && trades[2].quantity_ == 2 && trades[2].aggressor_ == Side::Sell);
+    }
+    CHECK(book.GetTrades(1, 1).size() == 1 && book.GetTrades(1, 1)[0].sequence_ == 1);
+    CHECK(book.GetTrades(3, 10).empty());
+    CHECK(book.FindTrade(0) == 0 && book.FindTrade(1005) == 0 && book.FindTrade(1006) == 2 && book.FindTrade(1010) == 2);
+    CHECK(book.FindTrade(1011) == 3);
+
+    // go round the tape: one trade a tick from here on, so trade s (s >= 3) is at time 2000 + s.
+    std::uint64_t total = TradeTape::Capacity + 1000;
+    for (std::uint64_t sequence = 3; sequence < total; sequence++){
+        now = 2000 + static_cast<Timestamp>(sequence);
+        OrderId id = 10 + 2 * sequence;
+        book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 100, 1, id));
+        book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 100, 1, id + 1));
+    }
+    CHECK(book.GetTradeCount() == total);
+    std::uint64_t oldest = total - TradeTape::Capacity;
+    // a reader copying the oldest slot can't tell whether the next append is already overwriting it, so it gives that
+    // one up and starts from the trade after.
+    trades = book.GetTrades(0, TradeTape::Capacity * 2);
+    CHECK(trades.size() == TradeTape::Capacity - 1 && trades.front().sequence_ == oldest + 1 && trades.back().sequence_ == total - 1);
+    trades = book.GetTrades(oldest + 1, 3);
+    CHECK(trades.size() == 3 && trades[0].sequence_ == oldest + 1 && trades[2].sequence_ == oldest + 3);
+    CHECK(trades.size() == 3 && trades[0].timestamp_ == 2000 + static_cast<Timestamp>(oldest + 1));
+    trades = book.GetTrades(total - 2, 10);
+    CHECK(trades.size() == 2 && trades[1].sequence_ == total - 1 && trades[1].buyOrderId_ == 10 + 2 * (total - 1) + 1);
+    CHECK(book.FindTrade(0) == oldest);
+    CHECK(book.FindTrade(2000 + 5000) == 5000 && book.FindTrade(2000 + static_cast<Timestamp>(total) - 1) == total - 1);
+    CHECK(book.FindTrade(2000 + static_cast<Timestamp>(total)) == total);
+}
+
+// every interval's bars are the tape's executions grouped by interval start: first/max/min/last price, the summed
+// volume, and the notional that makes notional_ / volume_ the bar's VWAP.
+void CandlesAggregateTheTape(){
+    Timestamp now = 10'000;
+    Orderbook book([&now]{ return now; });
+    book.SetCandleIntervals({ 1000, 5000 });
+    CHECK(!book.GetCandles(60 * 1000, 0, 10).has_value());
+    CHECK(book.GetCandles(1000, 0, 10).has_value() && book.GetCandles(1000, 0, 10)->empty());
+
+    std::uint64_t state = 48;
+    auto next = [&state](std::uint64_t bound){
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return (state >> 33) % bound;
+    };
+    for (OrderId id = 1; id <= 2000; id += 2){
+        now += static_cast<Timestamp>(next(150)); // quiet seconds leave no bar behind
+        Price price = static_cast<Price>(95 + next(11));
+        Side side = next(2) ? Side::Buy : Side::Sell;
+        Quantity quantity = static_cast<Quantity>(1 + next(20));
+        book.AddOrder(MakeOrder(OrderType::GoodTillCancel, side, price, quantity, id));
+        book.AddOrder(MakeOrder(OrderType::GoodTillCancel, side == Side::Buy ? Side::Sell : Side::Buy, price, quantity, id + 1));
+    }
+    std::vector<TapeTrade> tape = book.GetTrades(0, TradeTape::Capacity);
+    CHECK(tape.size() == 1000);
+
+    for (Timestamp interval : { Timestamp{ 1000 }, Timestamp{ 5000 } }){
+        std::vector<Candle> expected;
+        for (const TapeTrade& trade : tape){
+            Timestamp start = trade.timestamp_ - trade.timestamp_ % interval;
+            if (expected.empty() || expected.back().start_ != start){
+                expected.push_back(Candle{ start, trade.price_, trade.price_, trade.price_, trade.price_ });
+            }
+            Candle& bar = expected.back();
+            bar.high_ = std::max(bar.high_, trade.price_);
+            bar.low_ = std::min(bar.low_, trade.price_);
+            bar.close_ = trade.price_;
+            bar.volume_ += trade.quantity_;
+            bar.notional_ += std::int64_t{ trade.price_ } * trade.quantity_;
+            bar.trades_++;
+        }
+        auto candles = book.GetCandles(interval, 0, CandleSeries::Capacity);
+        CHECK(candles.has_value() && candles->size() == expected.size());
+        for (std::size_t i = 0; candles && i < std::min(candles->size(), expected.size()); i++){
+            const Candle& bar = (*candles)[i];
+            const Candle& want = expected[i];
+            CHECK(bar.start_ == want.start_ && bar.open_ == want.open_ && bar.high_ == want.high_ && bar.low_ == want.low_);
+            CHECK(bar.close_ == want.close_ && bar.volume_ == want.volume_ && bar.notional_ == want.notional_ && bar.trades_ == want.trades_);
+            CHECK(bar.low_ * static_cast<std::int64_t>(bar.volume_) <= bar.notional_ && bar.notional_ <= bar.high_ * static_cast<std::int64_t>(bar.volume_));
+        }
+
+        // "from" keeps the bars starting at or after it, "limit" the latest ones.
+        auto latest = book.GetCandles(interval, 0, 3);
+        CHECK(latest.has_value() && latest->size() == 3 && latest->back().start_ == expected.back().start_);
+        Timestamp from = expected[expected.size() / 2].start_;
+        auto since = book.GetCandles(interval, from, CandleSeries::Capacity);
+        CHECK(since.has_value() && since->size() == expected.size() - expected.size() / 2 && since->front().start_ == from);
+    }
+
+    // a clock that steps back folds its trade into the bar that is open.
+    auto before = book.GetCandles(1000, 0, 1);
+    now -= 2000;
+    book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 200, 1, 5000));
+    book.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Sell, 200, 1, 5001));
+    auto after = book.GetCandles(1000, 0, 1);
+    CHECK(before && after && after->size() == 1 && after->front().start_ == before->front().start_);
+    CHECK(after && !after->empty() && after->front().high_ == 200 && after->front().close_ == 200 && after->front().trades_ == before->front().trades_ + 1);
+
+    // new intervals start from nothing.
+    book.SetCandleIntervals({ 1000 });
+    CHECK(book.GetCandles(1000, 0, 10).has_value() && book.GetCandles(1000, 0, 10)->empty());
+    CHECK(!book.GetCandles(5000, 0, 10).has_value());
+}
+
+// a replica applying the primary's journal records one by one ends up with the primary's book, checksum for checksum.
+// the checksum is the replica's only way to notice it went wrong, so a missing or altered record has to change it.
+void JournalReplayReproducesTheChecksum(){
+    struct Record{
+        Timestamp time_;
+        std::string line_; // "op args...", as the server journals it
+    };
+    Timestamp now = 0;
+    Orderbook primary([&now]{ return now; });
+    std::vector<Record> journal;
+    std::vector<std::uint64_t> checksums; // the primary's after each record
+
+    std::uint64_t state = 49;
+    auto next = [&state](std::uint64_t bound){
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return (state >> 33) % bound;
+    };
+    // one order that stays put under everything else, so the book never depends on it arriving.
+    journal.push_back({ now, "trade 1 0 0 90 10 0 0 0 0 0" });
+    primary.AddOrder(MakeOrder(OrderType::GoodTillCancel, Side::Buy, 90, 10, 1));
+    checksums.push_back(primary.Checksum());
+    for (OrderId id = 2; id <= 1500; id++){
+        now += static_cast<Timestamp>(next(20));
+        std::uint64_t kind = next(20);
+        if (kind < 3){
+            OrderId victim = 2 + next(id);
+            primary.CancelOrder(victim);
+            journal.push_back({ now, std::format("cancel {}", victim) });
+        }else if (kind < 5){
+            OrderId victim = 2 + next(id);
+            Side side = next(2) ? Side::Buy : Side::Sell;
+            Price price = static_cast<Price>(95 + next(11));
+            Quantity quantity = static_cast<Quantity>(1 + next(30));
+            primary.MatchOrder(OrderModify{ victim, side, price, quantity });
+            journal.push_back({ now, std::format("modify {} {} {} {}", victim, static_cast<int>(side), price, quantity) });
+        }else if (kind == 5){
+            primary.ExpireOrders();
+            journal.push_back({ now, "expire" });
+        }else{
+            OrderType type = next(4) ? OrderType::GoodTillCancel : (next(2) ? OrderType::GoodTillTime : OrderType::FillAndKill);
+            Side side = next(2) ? Side::Buy : Side::Sell;
+            auto order = MakeOrder(type, side, static_cast<Price>(95 + next(11)), static_cast<Quantity>(1 + next(30)), id,
+                static_cast<AccountId>(next(4)), static_cast<SelfTradePrevention>(next(2)));
+            if (type == OrderType::GoodTillTime){
+                order->SetExpiry(now + 1 + static_cast<Timestamp>(next(200)));
+            }
+            if (next(6) == 0){
+                order->SetDisplayQuantity(static_cast<Quantity>(1 + next(5)));
+            }
+            journal.push_back({ now, std::format("trade {} {} {} {} {} {} {} {} {} {}", id, static_cast<int>(type),
+                static_cast<int>(side), order->GetPrice(), order->GetInitialQuantity(), order->GetExpiry(), order->GetStopPrice(),
+                order->GetDisplayQuantity(), order->GetOwner(), static_cast<int>(order->GetSelfTradePrevention())) });
+            primary.AddOrder(order);
+        }
+        checksums.push_back(primary.Checksum());
+    }
+    primary.CancelOrders(MassCancelFilter{ .side_ = Side::Sell, .maxPrice_ = 100 });
+    journal.push_back({ now, "cancelall 1 - 100 -" });
+    checksums.push_back(primary.Checksum());
+
+    // replays "journal" on a fresh book, with "change" applied to record "at" first. the checksum after each record.
+    auto replay = [&journal](std::size_t at, const std::function<std::string(const std::string&)>& change){
+        Timestamp time = 0;
+        Orderbook replica([&time]{ return time; });
+        std::vector<std::uint64_t> seen;
+        for (std::size_t i = 0; i < journal.size(); i++){
+            std::string line = i == at ? change(journal[i].line_) : journal[i].line_;
+            std::istringstream fields(line);
+            std::string op;
+            fields >> op;
+            time = journal[i].time_;
+            if (!op.empty()){
+                CHECK(ApplyBookRecord(replica, op, fields, [](OrderId){ }));
+            }
+            seen.push_back(replica.Checksum());
+        }
+        return seen;
+    };
+    auto same = [](const std::string& line){ return line; };
+    CHECK(replay(journal.size(), same) == checksums);
+
+    // a record that goes missing, or one with a different quantity, shows up at the latest by the end of the journal.
+    auto dropped = replay(0, [](const std::string&){ return std::string{ }; });
+    CHECK(dropped.front() != checksums.front() && dropped.back() != checksums.back());
+    auto changed = replay(0, [](const std::string& line){
+        std::istringstream fields(line);
+        std::vector<std::string> words{ std::istream_iterator<std::string>(fields), std::istream_iterator<std::string>() };
+        words[5] = std::to_string(std::stoul(words[5]) + 1);
+        std::string result;
+        for (const std::string& word : words){
+            result += (result.empty() ? "" : " ") + word;
+        }
+        return result;
+    });
+    CHECK(changed.front() != checksums.front());
+
+    std::istringstream bad("x 1 2");
+    CHECK(!ApplyBookRecord(primary, "trade", bad, [](OrderId){ }));
+    std::istringstream unknown("");
+    CHECK(!ApplyBookRecord(primary, "launch", unknown, [](OrderId){ }));
+}
+
+}
+
+int main(){
+    const std::vector<std::pair<const char*, std::function<void()>>> tests{
+        { "FillOrKillHonoursSelfTradePrevention", FillOrKillHonoursSelfTradePrevention },
+        { "ModifyIsRiskCheckedBeforeTheOrderMoves", ModifyIsRiskCheckedBeforeTheOrderMoves },
+        { "QuoteLegsAreRiskChecked", QuoteLegsAreRiskChecked },
+        { "OrdersRefusedOnArrivalAreRejected", OrdersRefusedOnArrivalAreRejected },
+        { "MarketOrderSweepsWithoutALimit", MarketOrderSweepsWithoutALimit },
+        { "FillOrKillFillsCompletelyOrNotAtAll", FillOrKillFillsCompletelyOrNotAtAll },
+        { "GoodTillTimeOrdersExpireInOneBatch", GoodTillTimeOrdersExpireInOneBatch },
+        { "StopCascadeRunsInStopPriceThenArrivalOrder", StopCascadeRunsInStopPriceThenArrivalOrder },
+        { "IcebergRefillsAtTheBackOfTheQueue", IcebergRefillsAtTheBackOfTheQueue },
+        { "SelfTradePreventionModesInTheMatchLoop", SelfTradePreventionModesInTheMatchLoop },
+        { "AuctionUncrossesAtTheEquilibriumPrice", AuctionUncrossesAtTheEquilibriumPrice },
+        { "RiskLimitsComeFromTheAccountCounters", RiskLimitsComeFromTheAccountCounters },
+        { "MirroredFlowsTradeTheSame", MirroredFlowsTradeTheSame },
+        { "PooledOrdersMatchAReferenceModel", PooledOrdersMatchAReferenceModel },
+        { "RefusalsComeBackAsErrors", RefusalsComeBackAsErrors },
+        { "ModifyKeepsPriorityOnlyForACut", ModifyKeepsPriorityOnlyForACut },
+        { "RequoteUpdatesTheLiveLegs", RequoteUpdatesTheLiveLegs },
+        { "MassCancelMatchesEveryFilter", MassCancelMatchesEveryFilter },
+        { "TopOfBookFollowsTheTouch", TopOfBookFollowsTheTouch },
+        { "FillEstimatesMatchAWalkOfTheLevels", FillEstimatesMatchAWalkOfTheLevels },
+        { "OrderStatusTracksTheQueueAhead", OrderStatusTracksTheQueueAhead },
+        { "TradeTapeKeepsSequenceAndTime", TradeTapeKeepsSequenceAndTime },
+        { "CandlesAggregateTheTape", CandlesAggregateTheTape },
+        { "JournalReplayReproducesTheChecksum", JournalReplayReproducesTheChecksum },
+    };
+    for (const auto& [name, test] : tests){
+        int before = gFailures;
+        test();
+        std::cout << std::format("{} {}\n", gFailures == before ? "ok  " : "FAIL", name);
+    }
+    return gFailures == 0 ? 0 : 1;
+}
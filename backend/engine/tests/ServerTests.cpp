@@ -0,0 +1,152 @@
+// Tests for the pieces of the server that aren't the engine itself: the latency histograms, the book registry and the
+// order router. They are driven directly, without HTTP, the same way OrderbookTests.cpp drives the engine.
+
+#include "BookRegistry.h"
+#include "LatencyHistogram.h"
+
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int gFailures = 0;
+
+#define CHECK(condition) \
+    do{ \
+        if (!(condition)){ \
+            std::cerr << std::format("{}:{}: CHECK({}) failed\n", __FILE__, __LINE__, #condition); \
+            gFailures++; \
+        } \
+    }while (false)
+
+// values below 16 get a bucket each. past that every percentile is the top of a bucket at most 1/16 wider than the
+// value, so it is never below the exact answer and never more than ~6% above it.
+void HistogramPercentilesStayWithinABucket(){
+    LatencyHistogram empty;
+    CHECK(empty.Percentile(0.99) == 0);
+
+    LatencyHistogram small;
+    for (std::uint64_t value = 0; value < 16; value++){
+        small.Record(value);
+    }
+    CHECK(small.Count() == 16);
+    CHECK(small.Sum() == 120);
+    CHECK(small.Percentile(0.5) == 7);
+    CHECK(small.Percentile(1.0) == 15);
+
+    LatencyHistogram histogram;
+    std::vector<std::uint64_t> values;
+    for (std::uint64_t value = 1; value <= 100'000; value += 7){
+        histogram.Record(value * 13);
+        values.push_back(value * 13);
+    }
+    for (double q : { 0.5, 0.9, 0.99, 0.999 }){
+        std::uint64_t exact = values[static_cast<std::size_t>(q * static_cast<double>(values.size())) - 1];
+        std::uint64_t reported = histogram.Percentile(q);
+        CHECK(reported >= exact);
+        CHECK(reported <= exact + exact / 16);
+    }
+    CHECK(histogram.Percentile(1.0) >= values.back());
+}
+
+// names are interned once: ids are handed out in order, adding a name again finds the existing book, and a full
+// registry refuses new names without disturbing the ones it has.
+void BookRegistryInternsEachNameOnce(){
+    auto registry = std::make_unique<BookRegistry>(); // two large tables, too big for the stack
+    RiskLimits limits;
+    limits.maxOpenOrders_ = 7;
+    CHECK(registry->Find("AAPL") == BookRegistry::InvalidBook);
+
+    CHECK(registry->Add("AAPL", limits, { 1000 }, 5) == std::make_pair(BookId{ 0 }, true));
+    CHECK(registry->Add("MSFT", limits, { 1000 }, 5) == std::make_pair(BookId{ 1 }, true));
+    CHECK(registry->Add("AAPL", RiskLimits{ }, { }, 9) == std::make_pair(BookId{ 0 }, false));
+    CHECK(registry->Find("AAPL") == 0 && registry->Find("MSFT") == 1);
+    CHECK(registry->Find("AAPLX") == BookRegistry::InvalidBook);
+    CHECK(registry->Size() == 2);
+
+    // a book comes with the limits, candle intervals and clock it was added with.
+    Book& book = registry->Get(0);
+    CHECK(book.name_ == "AAPL" && book.id_ == 0 && book.now_ == 5);
+    CHECK(book.book_.GetRiskLimits().maxOpenOrders_ == 7);
+    CHECK(book.book_.GetCandles(1000, 0, 10).has_value() && !book.book_.GetCandles(60 * 1000, 0, 10).has_value());
+
+    for (BookId id = 2; id < BookRegistry::MaxBooks; id++){
+        CHECK(registry->Add(std::format("B{}", id), limits, { }, 0).first == id);
+    }
+    CHECK(registry->Add("ONEMORE", limits, { }, 0).first == BookRegistry::InvalidBook);
+    CHECK(registry->Find("ONEMORE") == BookRegistry::InvalidBook);
+    for (BookId id = 2; id < BookRegistry::MaxBooks; id++){
+        CHECK(registry->Find(std::format("B{}", id)) == id);
+    }
+    BookId visited = 0;
+    registry->ForEach([&visited](Book& entry){ CHECK(entry.id_ == visited++); });
+    CHECK(visited == BookRegistry::MaxBooks);
+}
+
+// ids below 2^32 land in a direct-mapped page, allocated on first use; an untouched page, an unused slot and an id
+// nobody recorded all find nothing. ids past the table go through the overflow map and behave the same way.
+void OrderRouterFindsTheBookEachOrderWentTo(){
+    auto router = std::make_unique<OrderRouter>(); // the page tables alone are over a megabyte
+    CHECK(router->Find(0) == BookRegistry::InvalidBook);
+    CHECK(router->Find(OrderRouter::PageSize * 3 + 5) == BookRegistry::InvalidBook);
+
+    router->Record(1, 0);
+    router->Record(OrderRouter::PageSize - 1, 7);
+    router->Record(OrderRouter::PageSize, 8); // first slot of the next page
+    CHECK(router->Find(1) == 0);
+    CHECK(router->Find(OrderRouter::PageSize - 1) == 7);
+    CHECK(router->Find(OrderRouter::PageSize) == 8);
+    CHECK(router->Find(2) == BookRegistry::InvalidBook);
+    CHECK(router->Find(OrderRouter::PageSize + 1) == BookRegistry::InvalidBook);
+    router->Record(1, 3); // a reused id routes to wherever it went last
+    CHECK(router->Find(1) == 3);
+
+    const OrderId lastDirect = OrderRouter::PageSize * OrderRouter::MaxPages - 1;
+    router->Record(lastDirect, 4);
+    router->Record(lastDirect + 1, 5);
+    router->Record(std::numeric_limits<OrderId>::max(), BookRegistry::MaxBooks - 1);
+    CHECK(router->Find(lastDirect) == 4);
+    CHECK(router->Find(lastDirect + 1) == 5);
+    CHECK(router->Find(std::numeric_limits<OrderId>::max()) == BookRegistry::MaxBooks - 1);
+    CHECK(router->Find(lastDirect + 2) == BookRegistry::InvalidBook);
+
+    // threads recording into pages nobody has touched yet all get the same page, so nothing written is lost.
+    std::vector<std::thread> threads;
+    for (BookId book = 0; book < 4; book++){
+        threads.emplace_back([&router, book]{
+            for (OrderId id = OrderRouter::PageSize * 10 + book; id < OrderRouter::PageSize * 14; id += 4){
+                router->Record(id, book);
+            }
+        });
+    }
+    for (std::thread& thread : threads){
+        thread.join();
+    }
+    bool all = true;
+    for (OrderId id = OrderRouter::PageSize * 10; id < OrderRouter::PageSize * 14; id++){
+        all = all && router->Find(id) == id % 4;
+    }
+    CHECK(all);
+}
+
+}
+
+int main(){
+    const std::vector<std::pair<const char*, std::function<void()>>> tests{
+        { "HistogramPercentilesStayWithinABucket", HistogramPercentilesStayWithinABucket },
+        { "BookRegistryInternsEachNameOnce", BookRegistryInternsEachNameOnce },
+        { "OrderRouterFindsTheBookEachOrderWentTo", OrderRouterFindsTheBookEachOrderWentTo },
+    };
+    for (const auto& [name, test] : tests){
+        int before = gFailures;
+        test();
+        std::cout << std::format("{} {}\n", gFailures == before ? "ok  " : "FAIL", name);
+    }
+    return gFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+package handlers
+
+import (
+	"encoding/json"
+	"fmt"
+	"io"
+	"net/http"
+	"net/url"
+	"strings"
+
+	"github.com/TanishqM1/Orderbook/api"
+	log "github.com/sirupsen/logrus"
+)
+
+// Auction opens or uncrosses a call auction on one book.
+func Auction(w http.ResponseWriter, r *http.Request) {
+	var params = api.AuctionFields{}
+	err := json.NewDecoder(r.Body).Decode(&params)
+
+	if err != nil {
+		log.Error(err)
+		api.HandleRequestError(w, err)
+		return
+	}
+
+	if params.Book == "" || (params.Action != "open" && params.Action != "uncross") {
+		api.HandleRequestError(w, fmt.Errorf("name is required, and action must be \"open\" or \"uncross\""))
+		return
+	}
+
+	urlValues := url.Values{}
+	urlValues.Set("book", params.Book)
+	urlValues.Set("action", params.Action)
+
+	reqBody := strings.NewReader(urlValues.Encode())
+
+	client := http.Client{}
+
+	cppServerURL := engines.Owner(params.Book) + "/auction"
+
+	log.Debugf("Forwarding auction request to C++ engine: %s with body: %s", cppServerURL, urlValues.Encode())
+
+	cppReq, err := http.NewRequest("POST", cppServerURL, reqBody)
+	if err != nil {
+		log.Errorf("Failed to create C++ request: %v", err)
+		api.HandleInternalError(w)
+		return
+	}
+
+	cppReq.Header.Set("Content-Type", "application/x-www-form-urlencoded")
+
+	cppResp, err := client.Do(cppReq)
+	if err != nil {
+		log.Errorf("Failed to connect to C++ engine at %s. Is the C++ server running? Error: %v", cppServerURL, err)
+		api.HandleInternalError(w)
+		return
+	}
+	defer cppResp.Body.Close()
+
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(cppResp.StatusCode)
+
+	if _, err := io.Copy(w, cppResp.Body); err != nil {
+		log.Errorf("Failed to proxy response body: %v", err)
+	}
+}
+
+// AuctionStatus returns a book's trading phase and, during a call, its indicative uncross price and volume.
+func AuctionStatus(w http.ResponseWriter, r *http.Request) {
+	book := r.URL.Query().Get("name")
+	if book == "" {
+		api.HandleRequestError(w, fmt.Errorf("name query parameter is required"))
+		return
+	}
+
+	client := http.Client{}
+
+	cppServerURL := engines.Owner(book) + "/auction?" + url.Values{"book": {book}}.Encode()
+
+	log.Debugf("Forwarding auction status request to C++ engine: %s", cppServerURL)
+
+	cppReq, err := http.NewRequest("GET", cppServerURL, nil)
+	if err != nil {
+		log.Errorf("Failed to create C++ request: %v", err)
+		api.HandleInternalError(w)
+		return
+	}
+
+	cppResp, err := client.Do(cppReq)
+	if err != nil {
+		log.Errorf("Failed to connect to C++ engine at %s. Is the C++ server running? Error: %v", cppServerURL, err)
+		api.HandleInternalError(w)
+		return
+	}
+	defer cppResp.Body.Close()
+
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(cppResp.StatusCode)
+
+	if _, err := io.Copy(w, cppResp.Body); err != nil {
+		log.Errorf("Failed to copy proxy response body: %v", err)
+	}
+}
@@ -0,0 +1,46 @@
+package handlers
+
+import (
+	"io"
+	"net/http"
+	"net/url"
+
+	"github.com/TanishqM1/Orderbook/api"
+	log "github.com/sirupsen/logrus"
+)
+
+func BBO(w http.ResponseWriter, r *http.Request) {
+	book := r.URL.Query().Get("name")
+	if book == "" {
+		// every book's top of book, from every shard.
+		writeMergedBooks(w, fanOut("GET", "/bbo", nil))
+		return
+	}
+	cppServerURL := engines.Owner(book) + "/bbo?" + url.Values{"book": {book}}.Encode()
+
+	client := http.Client{}
+
+	log.Debugf("Forwarding top of book request to C++ engine: %s", cppServerURL)
+
+	cppReq, err := http.NewRequest("GET", cppServerURL, nil)
+	if err != nil {
+		log.Errorf("Failed to create C++ request: %v", err)
+		api.HandleInternalError(w)
+		return
+	}
+
+	cppResp, err := client.Do(cppReq)
+	if err != nil {
+		log.Errorf("Failed to connect to C++ engine at %s. Is the C++ server running? Error: %v", cppServerURL, err)
+		api.HandleInternalError(w)
+		return
+	}
+	defer cppResp.Body.Close()
+
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(cppResp.StatusCode)
+
+	if _, err := io.Copy(w, cppResp.Body); err != nil {
+		log.Errorf("Failed to copy proxy response body: %v", err)
+	}
+}
@@ -0,0 +1,65 @@
+package handlers
+
+import (
+	"encoding/json"
+	"fmt"
+	"io"
+	"net/http"
+	"net/url"
+	"strings"
+
+	"github.com/TanishqM1/Orderbook/api"
+	log "github.com/sirupsen/logrus"
+)
+
+// AddBook creates a book on the engine shard that owns its name, so it can be traded through the gateway.
+func AddBook(w http.ResponseWriter, r *http.Request) {
+	var params = api.BookFields{}
+	err := json.NewDecoder(r.Body).Decode(&params)
+
+	if err != nil {
+		log.Error(err)
+		api.HandleRequestError(w, err)
+		return
+	}
+
+	if params.Book == "" {
+		api.HandleRequestError(w, fmt.Errorf("name field is required"))
+		return
+	}
+
+	urlValues := url.Values{}
+	urlValues.Set("book", params.Book)
+
+	reqBody := strings.NewReader(urlValues.Encode())
+
+	client := http.Client{}
+
+	cppServerURL := engines.Owner(params.Book) + "/books"
+
+	log.Debugf("Forwarding add book request to C++ engine: %s with body: %s", cppServerURL, urlValues.Encode())
+
+	cppReq, err := http.NewRequest("POST", cppServerURL, reqBody)
+	if err != nil {
+		log.Errorf("Failed to create C++ request: %v", err)
+		api.HandleInternalError(w)
+		return
+	}
+
+	cppReq.Header.Set("Content-Type", "application/x-www-form-urlencoded")
+	cppResp, err := client.Do(cppReq)
+
+	if err != nil {
+		log.Errorf("Failed to connect to C++ engine at %s. Is the C++ server running? Error: %v", cppServerURL, err)
+		api.HandleInternalError(w)
+		return
+	}
+	defer cppResp.Body.Close()
+
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(cppResp.StatusCode)
+
+	if _, err := io.Copy(w, cppResp.Body); err != nil {
+		log.Errorf("Failed to proxy response body: %v", err)
+	}
+}
@@ -27,17 +27,26 @@ func Cancel(w http.ResponseWriter, r *http.Request) {
 
 	if params.OrderId == 0 {
 		api.HandleRequestError(w, fmt.Errorf("orderId field is required, and cannot be zero"))
+		return
 	}
 
 	URL_Values := url.Values{}
 	URL_Values.Set("orderid", strconv.FormatUint(uint64(params.OrderId), 10))
-	URL_Values.Set("book", params.Book)
+	// the engine routes by order id when no book is given.
+	if params.Book != "" {
+		URL_Values.Set("book", params.Book)
+	}
+
+	if params.Book == "" && len(engines.shards) > 1 {
+		writeOrderReply(w, fanOut("POST", "/cancel", URL_Values))
+		return
+	}
 
 	reqBody := strings.NewReader(URL_Values.Encode())
 
 	client := http.Client{}
 
-	cppServerURL := "http://localhost:6060/cancel"
+	cppServerURL := engines.Owner(params.Book) + "/cancel"
 
 	log.Debugf("Forwarding cancel request to C++ engine: %s with body: %s", cppServerURL, URL_Values.Encode())
 
@@ -52,7 +61,7 @@ func Cancel(w http.ResponseWriter, r *http.Request) {
 	cppResp, err := client.Do(cppReq)
 
 	if err != nil {
-		log.Errorf("Failed to connect to C++ engine at :6060. Is the C++ server running? Error: %v", err)
+		log.Errorf("Failed to connect to C++ engine at %s. Is the C++ server running? Error: %v", cppServerURL, err)
 		api.HandleInternalError(w)
 		return
 	}
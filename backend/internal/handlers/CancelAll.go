@@ -0,0 +1,103 @@
+package handlers
+
+import (
+	"encoding/json"
+	"fmt"
+	"io"
+	"net/http"
+	"net/url"
+	"strconv"
+	"strings"
+
+	"github.com/TanishqM1/Orderbook/api"
+	log "github.com/sirupsen/logrus"
+)
+
+func CancelAll(w http.ResponseWriter, r *http.Request) {
+	var params = api.CancelAllFields{}
+	err := json.NewDecoder(r.Body).Decode(&params)
+
+	if err != nil {
+		log.Error(err)
+		api.HandleRequestError(w, err)
+		return
+	}
+
+	if params.Book == "" {
+		api.HandleRequestError(w, fmt.Errorf("name field is required, use \"*\" for every book"))
+		return
+	}
+
+	urlValues := url.Values{}
+	urlValues.Set("book", params.Book)
+	if params.Side != "" {
+		urlValues.Set("side", params.Side)
+	}
+	if params.MinPrice != nil {
+		urlValues.Set("minprice", strconv.Itoa(*params.MinPrice))
+	}
+	if params.MaxPrice != nil {
+		urlValues.Set("maxprice", strconv.Itoa(*params.MaxPrice))
+	}
+	if params.Account != nil {
+		urlValues.Set("account", strconv.FormatUint(uint64(*params.Account), 10))
+	}
+
+	if params.Book == "*" && len(engines.shards) > 1 {
+		writeCancelledTotal(w, fanOut("POST", "/cancelall", urlValues))
+		return
+	}
+
+	reqBody := strings.NewReader(urlValues.Encode())
+
+	client := http.Client{}
+
+	cppServerURL := engines.Owner(params.Book) + "/cancelall"
+
+	log.Debugf("Forwarding mass cancel to C++ engine: %s with body: %s", cppServerURL, urlValues.Encode())
+
+	cppReq, err := http.NewRequest("POST", cppServerURL, reqBody)
+	if err != nil {
+		log.Errorf("Failed to create C++ request: %v", err)
+		api.HandleInternalError(w)
+		return
+	}
+
+	cppReq.Header.Set("Content-Type", "application/x-www-form-urlencoded")
+	cppResp, err := client.Do(cppReq)
+
+	if err != nil {
+		log.Errorf("Failed to connect to C++ engine at %s. Is the C++ server running? Error: %v", cppServerURL, err)
+		api.HandleInternalError(w)
+		return
+	}
+	defer cppResp.Body.Close()
+
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(cppResp.StatusCode)
+
+	if _, err := io.Copy(w, cppResp.Body); err != nil {
+		log.Errorf("Failed to proxy response body: %v", err)
+	}
+}
+
+// the kill switch across every shard: each one cancels in its own books, and the counts are added up.
+func writeCancelledTotal(w http.ResponseWriter, replies []shardReply) {
+	if failed, found := failedReply(replies, func(status int) bool { return status == http.StatusOK }); found {
+		writeFailure(w, failed)
+		return
+	}
+	total := 0
+	for _, reply := range replies {
+		var result struct {
+			Cancelled int `json:"cancelled"`
+		}
+		if err := json.Unmarshal(reply.body, &result); err != nil {
+			log.Errorf("Bad response from the C++ engine at %s: %v", reply.shard, err)
+			api.HandleInternalError(w)
+			return
+		}
+		total += result.Cancelled
+	}
+	writeReply(w, shardReply{status: http.StatusOK, body: []byte(fmt.Sprintf(`{"message": "Orders cancelled", "cancelled": %d}`, total))})
+}
@@ -0,0 +1,56 @@
+package handlers
+
+import (
+	"fmt"
+	"io"
+	"net/http"
+	"net/url"
+
+	"github.com/TanishqM1/Orderbook/api"
+	log "github.com/sirupsen/logrus"
+)
+
+func Liquidity(w http.ResponseWriter, r *http.Request) {
+	query := r.URL.Query()
+	book, side := query.Get("name"), query.Get("side")
+	quantity, price := query.Get("quantity"), query.Get("price")
+	if book == "" || side == "" || (quantity == "") == (price == "") {
+		api.HandleRequestError(w, fmt.Errorf("name, side and one of quantity or price query parameters are required"))
+		return
+	}
+
+	values := url.Values{"book": {book}, "side": {side}}
+	if quantity != "" {
+		values.Set("quantity", quantity)
+	} else {
+		values.Set("price", price)
+	}
+
+	client := http.Client{}
+
+	cppServerURL := engines.Owner(book) + "/liquidity?" + values.Encode()
+
+	log.Debugf("Forwarding liquidity request to C++ engine: %s", cppServerURL)
+
+	cppReq, err := http.NewRequest("GET", cppServerURL, nil)
+	if err != nil {
+		log.Errorf("Failed to create C++ request: %v", err)
+		api.HandleInternalError(w)
+		return
+	}
+
+	cppResp, err := client.Do(cppReq)
+	if err != nil {
+		log.Errorf("Failed to connect to C++ engine at %s. Is the C++ server running? Error: %v", cppServerURL, err)
+		api.HandleInternalError(w)
+		return
+	}
+	defer cppResp.Body.Close()
+
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(cppResp.StatusCode)
+
+	if _, err := io.Copy(w, cppResp.Body); err != nil {
+		log.Errorf("Failed to copy proxy response body: %v", err)
+	}
+}
@@ -0,0 +1,76 @@
+package handlers
+
+import (
+	"encoding/json"
+	"fmt"
+	"io"
+	"net/http"
+	"net/url"
+	"strconv"
+	"strings"
+
+	"github.com/TanishqM1/Orderbook/api"
+	log "github.com/sirupsen/logrus"
+)
+
+func Modify(w http.ResponseWriter, r *http.Request) {
+	var params = api.ModifyFields{}
+	err := json.NewDecoder(r.Body).Decode(&params)
+
+	if err != nil {
+		log.Error(err)
+		api.HandleRequestError(w, err)
+		return
+	}
+
+	if params.OrderId == 0 {
+		api.HandleRequestError(w, fmt.Errorf("orderId field is required, and cannot be zero"))
+		return
+	}
+
+	urlValues := url.Values{}
+	urlValues.Set("orderid", strconv.FormatUint(uint64(params.OrderId), 10))
+	if params.Book != "" {
+		urlValues.Set("book", params.Book)
+	}
+	urlValues.Set("side", params.Side)
+	urlValues.Set("price", strconv.Itoa(params.Price))
+	urlValues.Set("quantity", strconv.Itoa(params.Quantity))
+
+	if params.Book == "" && len(engines.shards) > 1 {
+		writeOrderReply(w, fanOut("POST", "/modify", urlValues))
+		return
+	}
+
+	reqBody := strings.NewReader(urlValues.Encode())
+
+	client := http.Client{}
+
+	cppServerURL := engines.Owner(params.Book) + "/modify"
+
+	log.Debugf("Forwarding modify request to C++ engine: %s with body: %s", cppServerURL, urlValues.Encode())
+
+	cppReq, err := http.NewRequest("POST", cppServerURL, reqBody)
+	if err != nil {
+		log.Errorf("Failed to create C++ request: %v", err)
+		api.HandleInternalError(w)
+		return
+	}
+
+	cppReq.Header.Set("Content-Type", "application/x-www-form-urlencoded")
+	cppResp, err := client.Do(cppReq)
+
+	if err != nil {
+		log.Errorf("Failed to connect to C++ engine at %s. Is the C++ server running? Error: %v", cppServerURL, err)
+		api.HandleInternalError(w)
+		return
+	}
+	defer cppResp.Body.Close()
+
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(cppResp.StatusCode)
+
+	if _, err := io.Copy(w, cppResp.Body); err != nil {
+		log.Errorf("Failed to proxy response body: %v", err)
+	}
+}
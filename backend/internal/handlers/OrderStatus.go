@@ -0,0 +1,58 @@
+package handlers
+
+import (
+	"fmt"
+	"io"
+	"net/http"
+	"net/url"
+
+	"github.com/TanishqM1/Orderbook/api"
+	log "github.com/sirupsen/logrus"
+)
+
+func OrderStatus(w http.ResponseWriter, r *http.Request) {
+	query := r.URL.Query()
+	id, book := query.Get("id"), query.Get("name")
+	if id == "" {
+		api.HandleRequestError(w, fmt.Errorf("id query parameter is required"))
+		return
+	}
+
+	values := url.Values{"id": {id}}
+	if book != "" {
+		values.Set("book", book)
+	}
+
+	if book == "" && len(engines.shards) > 1 {
+		writeOrderReply(w, fanOut("GET", "/order?"+values.Encode(), nil))
+		return
+	}
+
+	client := http.Client{}
+
+	cppServerURL := engines.Owner(book) + "/order?" + values.Encode()
+
+	log.Debugf("Forwarding order status request to C++ engine: %s", cppServerURL)
+
+	cppReq, err := http.NewRequest("GET", cppServerURL, nil)
+	if err != nil {
+		log.Errorf("Failed to create C++ request: %v", err)
+		api.HandleInternalError(w)
+		return
+	}
+
+	cppResp, err := client.Do(cppReq)
+	if err != nil {
+		log.Errorf("Failed to connect to C++ engine at %s. Is the C++ server running? Error: %v", cppServerURL, err)
+		api.HandleInternalError(w)
+		return
+	}
+	defer cppResp.Body.Close()
+
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(cppResp.StatusCode)
+
+	if _, err := io.Copy(w, cppResp.Body); err != nil {
+		log.Errorf("Failed to copy proxy response body: %v", err)
+	}
+}
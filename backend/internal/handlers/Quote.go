@@ -0,0 +1,118 @@
+package handlers
+
+import (
+	"encoding/json"
+	"fmt"
+	"io"
+	"net/http"
+	"net/url"
+	"strconv"
+	"strings"
+
+	"github.com/TanishqM1/Orderbook/api"
+	log "github.com/sirupsen/logrus"
+)
+
+func Quote(w http.ResponseWriter, r *http.Request) {
+	var params = api.QuoteFields{}
+	err := json.NewDecoder(r.Body).Decode(&params)
+
+	if err != nil {
+		log.Error(err)
+		api.HandleRequestError(w, err)
+		return
+	}
+
+	if params.Account == 0 || len(params.Quotes) == 0 {
+		api.HandleRequestError(w, fmt.Errorf("account and at least one quote are required"))
+		return
+	}
+
+	// every leg gets a fresh id. the engine only uses it if the account has no live order on that side of the book yet.
+	// legs are grouped by the shard that owns their book, each shard applies or refuses its group as one.
+	var shards []string
+	groups := map[string]url.Values{}
+	for _, quote := range params.Quotes {
+		shard := engines.Owner(quote.Book)
+		values, found := groups[shard]
+		if !found {
+			values = url.Values{}
+			values.Set("account", strconv.FormatUint(uint64(params.Account), 10))
+			values.Set("stp", params.STP)
+			groups[shard] = values
+			shards = append(shards, shard)
+		}
+		values.Add("quote", fmt.Sprintf("%s,%d,%d,%d,%d,%d,%d", quote.Book,
+			api.GetNextOrderId(), quote.BidPrice, quote.BidQty,
+			api.GetNextOrderId(), quote.AskPrice, quote.AskQty))
+	}
+
+	if len(shards) > 1 {
+		requests := make([]shardRequest, len(shards))
+		for i, shard := range shards {
+			requests[i] = shardRequest{shard, "POST", "/quote", groups[shard]}
+		}
+		writeMergedQuotes(w, sendAll(requests))
+		return
+	}
+	urlValues := groups[shards[0]]
+
+	reqBody := strings.NewReader(urlValues.Encode())
+
+	client := http.Client{}
+
+	cppServerURL := shards[0] + "/quote"
+
+	log.Debugf("Forwarding quote request to C++ engine: %s with body: %s", cppServerURL, urlValues.Encode())
+
+	cppReq, err := http.NewRequest("POST", cppServerURL, reqBody)
+	if err != nil {
+		log.Errorf("Failed to create C++ request: %v", err)
+		api.HandleInternalError(w)
+		return
+	}
+
+	cppReq.Header.Set("Content-Type", "application/x-www-form-urlencoded")
+	cppResp, err := client.Do(cppReq)
+
+	if err != nil {
+		log.Errorf("Failed to connect to C++ engine at %s. Is the C++ server running? Error: %v", cppServerURL, err)
+		api.HandleInternalError(w)
+		return
+	}
+	defer cppResp.Body.Close()
+
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(cppResp.StatusCode)
+
+	if _, err := io.Copy(w, cppResp.Body); err != nil {
+		log.Errorf("Failed to proxy response body: %v", err)
+	}
+}
+
+// a mass quote over several shards: one list of legs when every shard took its part. otherwise the first refusal is
+// passed on, and the shards that took theirs keep them.
+func writeMergedQuotes(w http.ResponseWriter, replies []shardReply) {
+	if failed, found := failedReply(replies, func(status int) bool { return status == http.StatusOK }); found {
+		writeFailure(w, failed)
+		return
+	}
+	var merged []json.RawMessage
+	for _, reply := range replies {
+		var result struct {
+			Quotes []json.RawMessage `json:"quotes"`
+		}
+		if err := json.Unmarshal(reply.body, &result); err != nil {
+			log.Errorf("Bad response from the C++ engine at %s: %v", reply.shard, err)
+			api.HandleInternalError(w)
+			return
+		}
+		merged = append(merged, result.Quotes...)
+	}
+	body, err := json.Marshal(map[string]any{"message": "Quotes updated", "quotes": merged})
+	if err != nil {
+		api.HandleInternalError(w)
+		return
+	}
+	writeReply(w, shardReply{status: http.StatusOK, body: body})
+}
@@ -0,0 +1,243 @@
+package handlers
+
+import (
+	"encoding/json"
+	"hash/fnv"
+	"io"
+	"net/http"
+	"net/url"
+	"os"
+	"sort"
+	"strconv"
+	"strings"
+	"sync"
+
+	"github.com/TanishqM1/Orderbook/api"
+	log "github.com/sirupsen/logrus"
+)
+
+// Books can be spread over several engine processes (shards), listed in ORDERBOOK_SHARDS as comma separated host:port
+// (just localhost:6060 when it isn't set). Each book belongs to the shard that owns its name on a consistent-hash ring,
+// so adding or removing a shard only moves the books that hash next to it. The ring only depends on the shard list, so
+// every gateway started with the same list routes every book the same way.
+
+// points each shard gets on the ring, so books spread evenly even with two or three shards.
+const virtualNodes = 64
+
+type ringPoint struct {
+	hash  uint64
+	shard int
+}
+
+type shardRing struct {
+	shards []string // engine base URLs, e.g. http://localhost:6060
+	points []ringPoint
+}
+
+// FNV-1a, then a 64-bit finalizer: names and shard addresses differ in their last few bytes, which FNV alone leaves in
+// the low bits.
+func ringHash(key string) uint64 {
+	hash := fnv.New64a()
+	hash.Write([]byte(key))
+	x := hash.Sum64()
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9
+	x = (x ^ (x >> 27)) * 0x94d049bb133111eb
+	return x ^ (x >> 31)
+}
+
+func newShardRing(addresses []string) *shardRing {
+	ring := &shardRing{}
+	for i, address := range addresses {
+		ring.shards = append(ring.shards, "http://"+address)
+		for node := 0; node < virtualNodes; node++ {
+			ring.points = append(ring.points, ringPoint{ringHash(address + "#" + strconv.Itoa(node)), i})
+		}
+	}
+	sort.Slice(ring.points, func(i, j int) bool { return ring.points[i].hash < ring.points[j].hash })
+	return ring
+}
+
+// Owner is the base URL of the shard that holds book: the first point at or after the name's hash, wrapping around.
+func (ring *shardRing) Owner(book string) string {
+	if len(ring.shards) == 1 {
+		return ring.shards[0]
+	}
+	hash := ringHash(book)
+	i := sort.Search(len(ring.points), func(i int) bool { return ring.points[i].hash >= hash })
+	if i == len(ring.points) {
+		i = 0
+	}
+	return ring.shards[ring.points[i].shard]
+}
+
+var engines = newShardRing([]string{"localhost:6060"})
+
+// reads ORDERBOOK_SHARDS. when it is set the gateway also creates the books of ORDERBOOK_SYMBOLS (the engine's default
+// list if that isn't set either) on their owners, so each engine should be started with an empty ORDERBOOK_SYMBOLS.
+func setupShards() {
+	list := os.Getenv("ORDERBOOK_SHARDS")
+	if list == "" {
+		return
+	}
+	var addresses []string
+	for _, address := range strings.Split(list, ",") {
+		if address = strings.TrimSpace(address); address != "" {
+			addresses = append(addresses, address)
+		}
+	}
+	if len(addresses) == 0 {
+		return
+	}
+	engines = newShardRing(addresses)
+	log.Infof("Routing books over %d engine shards: %s", len(addresses), strings.Join(addresses, ", "))
+
+	symbols, set := os.LookupEnv("ORDERBOOK_SYMBOLS")
+	if !set {
+		symbols = "AAPL,AMZN,GOOG,META,MSFT,NVDA,TSLA"
+	}
+	for _, book := range strings.Split(symbols, ",") {
+		if book == "" {
+			continue
+		}
+		reply := send(shardRequest{engines.Owner(book), "POST", "/books", url.Values{"book": {book}}})
+		if reply.err != nil || reply.status >= 300 {
+			log.Errorf("Failed to add book %s on %s: %v %s", book, reply.shard, reply.err, reply.body)
+		}
+	}
+}
+
+type shardRequest struct {
+	shard  string
+	method string
+	path   string     // with its query string, if any
+	form   url.Values // the POST body, nil for a GET
+}
+
+// one shard's answer. err is set when it couldn't be reached.
+type shardReply struct {
+	shard  string
+	status int
+	body   []byte
+	err    error
+}
+
+func send(request shardRequest) shardReply {
+	reply := shardReply{shard: request.shard}
+	var body io.Reader
+	if request.form != nil {
+		body = strings.NewReader(request.form.Encode())
+	}
+	cppReq, err := http.NewRequest(request.method, request.shard+request.path, body)
+	if err != nil {
+		reply.err = err
+		return reply
+	}
+	if request.form != nil {
+		cppReq.Header.Set("Content-Type", "application/x-www-form-urlencoded")
+	}
+
+	client := http.Client{}
+	cppResp, err := client.Do(cppReq)
+	if err != nil {
+		reply.err = err
+		return reply
+	}
+	defer cppResp.Body.Close()
+	reply.status = cppResp.StatusCode
+	reply.body, reply.err = io.ReadAll(cppResp.Body)
+	return reply
+}
+
+// sends every request at once and waits for all the replies, in the same order.
+func sendAll(requests []shardRequest) []shardReply {
+	replies := make([]shardReply, len(requests))
+	var wait sync.WaitGroup
+	for i, request := range requests {
+		wait.Add(1)
+		go func(i int, request shardRequest) {
+			defer wait.Done()
+			replies[i] = send(request)
+		}(i, request)
+	}
+	wait.Wait()
+	return replies
+}
+
+// the same request to every shard.
+func fanOut(method, path string, form url.Values) []shardReply {
+	requests := make([]shardRequest, len(engines.shards))
+	for i, shard := range engines.shards {
+		requests[i] = shardRequest{shard, method, path, form}
+	}
+	return sendAll(requests)
+}
+
+func writeReply(w http.ResponseWriter, reply shardReply) {
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(reply.status)
+	w.Write(reply.body)
+}
+
+// the first shard that couldn't be reached or answered with an error, if any.
+func failedReply(replies []shardReply, ok func(status int) bool) (shardReply, bool) {
+	for _, reply := range replies {
+		if reply.err != nil || !ok(reply.status) {
+			return reply, true
+		}
+	}
+	return shardReply{}, false
+}
+
+func writeFailure(w http.ResponseWriter, reply shardReply) {
+	if reply.err != nil {
+		log.Errorf("Failed to reach the C++ engine at %s. Is it running? Error: %v", reply.shard, reply.err)
+		api.HandleInternalError(w)
+		return
+	}
+	writeReply(w, reply)
+}
+
+// for an order named by id only: each engine finds its own orders by id, so every shard is asked and the one that
+// knows the order answers. when none does, their 404 is passed on.
+func writeOrderReply(w http.ResponseWriter, replies []shardReply) {
+	for _, reply := range replies {
+		if reply.err == nil && reply.status != http.StatusNotFound {
+			writeReply(w, reply)
+			return
+		}
+	}
+	if failed, found := failedReply(replies, func(status int) bool { return status == http.StatusNotFound }); found {
+		writeFailure(w, failed)
+		return
+	}
+	writeReply(w, replies[0])
+}
+
+// merges per-book JSON objects ({"BOOK": {...}, ...}, like /status and /bbo return) from every shard into one, keeping
+// each book only from the shard that owns it.
+func writeMergedBooks(w http.ResponseWriter, replies []shardReply) {
+	if failed, found := failedReply(replies, func(status int) bool { return status == http.StatusOK }); found {
+		writeFailure(w, failed)
+		return
+	}
+	merged := map[string]json.RawMessage{}
+	for _, reply := range replies {
+		var books map[string]json.RawMessage
+		if err := json.Unmarshal(reply.body, &books); err != nil {
+			log.Errorf("Bad response from the C++ engine at %s: %v", reply.shard, err)
+			api.HandleInternalError(w)
+			return
+		}
+		for book, value := range books {
+			if engines.Owner(book) == reply.shard {
+				merged[book] = value
+			}
+		}
+	}
+	body, err := json.Marshal(merged)
+	if err != nil {
+		api.HandleInternalError(w)
+		return
+	}
+	writeReply(w, shardReply{status: http.StatusOK, body: body})
+}
@@ -0,0 +1,119 @@
+package handlers
+
+import (
+	"encoding/json"
+	"fmt"
+	"net/http"
+	"net/http/httptest"
+	"testing"
+)
+
+func testShards(n int) []string {
+	var addresses []string
+	for i := 0; i < n; i++ {
+		addresses = append(addresses, fmt.Sprintf("10.0.0.%d:6060", i+1))
+	}
+	return addresses
+}
+
+func testBooks(n int) []string {
+	var books []string
+	for i := 0; i < n; i++ {
+		books = append(books, fmt.Sprintf("SYM%d", i))
+	}
+	return books
+}
+
+// every gateway started with the same shard list routes every book the same way, and always did.
+func TestOwnerIsDeterministic(t *testing.T) {
+	first := newShardRing(testShards(4))
+	second := newShardRing(testShards(4))
+	for _, book := range testBooks(1000) {
+		owner := first.Owner(book)
+		if again := first.Owner(book); again != owner {
+			t.Fatalf("%s: owner changed from %s to %s", book, owner, again)
+		}
+		if other := second.Owner(book); other != owner {
+			t.Fatalf("%s: two rings from the same list disagree: %s and %s", book, owner, other)
+		}
+	}
+
+	single := newShardRing([]string{"localhost:6060"})
+	if owner := single.Owner("AAPL"); owner != "http://localhost:6060" {
+		t.Fatalf("single shard: got %s", owner)
+	}
+}
+
+// with virtual nodes no shard ends up with far more or far fewer books than its share.
+func TestBooksSpreadOverTheShards(t *testing.T) {
+	const shards, books = 4, 4000
+	ring := newShardRing(testShards(shards))
+	counts := map[string]int{}
+	for _, book := range testBooks(books) {
+		counts[ring.Owner(book)]++
+	}
+	if len(counts) != shards {
+		t.Fatalf("books landed on %d shards, want %d", len(counts), shards)
+	}
+	for shard, count := range counts {
+		if count < books/shards/2 || count > books/shards*2 {
+			t.Errorf("%s holds %d books, want about %d", shard, count, books/shards)
+		}
+	}
+}
+
+// adding a shard only moves books onto it, and only about its share of them.
+func TestAddingAShardMovesOnlyItsShare(t *testing.T) {
+	const books = 4000
+	before := newShardRing(testShards(4))
+	after := newShardRing(testShards(5))
+	added := after.shards[4]
+	moved := 0
+	for _, book := range testBooks(books) {
+		old, current := before.Owner(book), after.Owner(book)
+		if old == current {
+			continue
+		}
+		if current != added {
+			t.Fatalf("%s moved from %s to %s, not to the new shard", book, old, current)
+		}
+		moved++
+	}
+	if moved == 0 || moved > books/5*2 {
+		t.Fatalf("%d of %d books moved, want about %d", moved, books, books/5)
+	}
+}
+
+// /status and /bbo keep each book only from the shard that owns it, whatever the other shards say about it.
+func TestMergedBooksComeFromTheirOwners(t *testing.T) {
+	saved := engines
+	defer func() { engines = saved }()
+	engines = newShardRing(testShards(3))
+
+	var replies []shardReply
+	for _, shard := range engines.shards {
+		books := map[string]string{}
+		for _, book := range testBooks(30) {
+			books[book] = shard
+		}
+		body, _ := json.Marshal(books)
+		replies = append(replies, shardReply{shard: shard, status: http.StatusOK, body: body})
+	}
+	recorder := httptest.NewRecorder()
+	writeMergedBooks(recorder, replies)
+	if recorder.Code != http.StatusOK {
+		t.Fatalf("status %d", recorder.Code)
+	}
+	var merged map[string]string
+	if err := json.Unmarshal(recorder.Body.Bytes(), &merged); err != nil {
+		t.Fatal(err)
+	}
+	if len(merged) != 30 {
+		t.Fatalf("merged %d books, want 30", len(merged))
+	}
+	for book, shard := range merged {
+		if owner := engines.Owner(book); shard != owner {
+			t.Errorf("%s came from %s, its owner is %s", book, shard, owner)
+		}
+	}
+}
@@ -32,13 +32,26 @@ func Trade(w http.ResponseWriter, r *http.Request) {
 	urlValues.Set("price", strconv.Itoa(params.Price))
 	urlValues.Set("quantity", strconv.Itoa(params.Quantity))
 	urlValues.Set("book", params.Name)
+	if params.Expiry != 0 {
+		urlValues.Set("expiry", strconv.FormatInt(params.Expiry, 10))
+	}
+	if params.StopPrice != nil {
+		urlValues.Set("stopprice", strconv.Itoa(*params.StopPrice))
+	}
+	if params.Display != 0 {
+		urlValues.Set("displayqty", strconv.Itoa(params.Display))
+	}
+	if params.Account != 0 {
+		urlValues.Set("account", strconv.FormatUint(uint64(params.Account), 10))
+		urlValues.Set("stp", params.STP)
+	}
 
 	reqBody := strings.NewReader(urlValues.Encode())
 
 	client := http.Client{}
 
-	// C++ server runs on :6060 with the /trade endpoint
-	cppServerURL := "http://localhost:6060/trade"
+	// the book's shard (see Shards.go) has the /trade endpoint
+	cppServerURL := engines.Owner(params.Name) + "/trade"
 
 	log.Debugf("Forwarding trade request to C++ engine: %s with body: %s", cppServerURL, urlValues.Encode())
 
@@ -53,7 +66,7 @@ func Trade(w http.ResponseWriter, r *http.Request) {
 
 	cppResp, err := client.Do(cppReq)
 	if err != nil {
-		log.Errorf("Failed to connect to C++ engine at :6060. Is the C++ server running? Error: %v", err)
+		log.Errorf("Failed to connect to C++ engine at %s. Is the C++ server running? Error: %v", cppServerURL, err)
 		api.HandleInternalError(w)
 		return
 	}
@@ -0,0 +1,55 @@
+package handlers
+
+import (
+	"fmt"
+	"io"
+	"net/http"
+	"net/url"
+
+	"github.com/TanishqM1/Orderbook/api"
+	log "github.com/sirupsen/logrus"
+)
+
+func Trades(w http.ResponseWriter, r *http.Request) {
+	query := r.URL.Query()
+	book := query.Get("name")
+	if book == "" {
+		api.HandleRequestError(w, fmt.Errorf("name query parameter is required"))
+		return
+	}
+
+	values := url.Values{"book": {book}}
+	for _, key := range []string{"since", "time", "limit"} {
+		if value := query.Get(key); value != "" {
+			values.Set(key, value)
+		}
+	}
+
+	client := http.Client{}
+
+	cppServerURL := engines.Owner(book) + "/trades?" + values.Encode()
+
+	log.Debugf("Forwarding trade tape request to C++ engine: %s", cppServerURL)
+
+	cppReq, err := http.NewRequest("GET", cppServerURL, nil)
+	if err != nil {
+		log.Errorf("Failed to create C++ request: %v", err)
+		api.HandleInternalError(w)
+		return
+	}
+
+	cppResp, err := client.Do(cppReq)
+	if err != nil {
+		log.Errorf("Failed to connect to C++ engine at %s. Is the C++ server running? Error: %v", cppServerURL, err)
+		api.HandleInternalError(w)
+		return
+	}
+	defer cppResp.Body.Close()
+
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(cppResp.StatusCode)
+
+	if _, err := io.Copy(w, cppResp.Body); err != nil {
+		log.Errorf("Failed to copy proxy response body: %v", err)
+	}
+}
@@ -8,6 +8,9 @@ import (
 )
 
 func Handler(r *chi.Mux) {
+	// which engine process each book lives on, see Shards.go
+	setupShards()
+
 	// strip trailing slashes (from chi package)
 	r.Use(chimiddle.StripSlashes)
 
@@ -30,8 +33,19 @@ func Handler(r *chi.Mux) {
 	// setup route (MUST be /order for your test URL)
 	r.Route("/order", func(router chi.Router) {
 		// We use lowercase "trade" here to match URL best practices
+		router.Get("/", OrderStatus)
 		router.Post("/trade", Trade)
 		router.Post("/cancel", Cancel)
+		router.Post("/modify", Modify)
+		router.Post("/quote", Quote)
+		router.Post("/cancelall", CancelAll)
 		router.Get("/status", Status)
+		router.Get("/bbo", BBO)
+		router.Get("/liquidity", Liquidity)
+		router.Get("/trades", Trades)
+		router.Get("/candles", Candles)
+		router.Post("/books", AddBook)
+		router.Post("/auction", Auction)
+		router.Get("/auction", AuctionStatus)
 	})
 }